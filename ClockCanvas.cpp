@@ -0,0 +1,419 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <QFontMetrics>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QVector>
+
+#include "ClockCanvas.h"
+
+#define TODMARGIN 160     // above and below the time of day
+#define LOGOMARGIN 32     // logo offset from the top left of the date
+#define CREDITMARGIN 32   // either side of the image credit
+#define CREDITBOTTOM 12   // below the image credit
+#define ROWGAP 24         // between a panel label and its reading
+
+ClockCanvas::ClockCanvas(QWidget *parent):QWidget(parent)
+{
+	setAttribute(Qt::WA_OpaquePaintEvent); // everything is painted from the static layer, so no need to erase
+	setMouseTracking(true); // so that mouse movements reach the parent and wake up the display
+	
+	bkColour = QColor(80,1,48);
+	statics[ImageInfo].alignment = Qt::AlignRight | Qt::AlignVCenter;
+	staticDirty=true;
+	prerendering=glyphAtlas=false;
+	panelColumns=1;
+	panelColour=tod.colour();
+}
+
+ClockCanvas::~ClockCanvas()
+{
+	qDeleteAll(rows);
+}
+
+void ClockCanvas::setBackground(const QImage &im)
+{
+	bkImage = im;
+	invalidateStatic(rect());
+}
+
+QImage ClockCanvas::background()
+{
+	return bkImage;
+}
+
+QRect ClockCanvas::backgroundRect()
+{
+	// centred, like a QLabel would
+	return QRect((width()-bkImage.width())/2,(height()-bkImage.height())/2,bkImage.width(),bkImage.height());
+}
+
+void ClockCanvas::setBackgroundColour(const QColor &c)
+{
+	if (bkColour == c) return;
+	bkColour=c;
+	if (bkImage.isNull())
+		invalidateStatic(rect());
+}
+
+void ClockCanvas::setLogo(const QImage &im)
+{
+	bool relayout = (im.size() != logoImage.size());
+	QRect old(logoPos,logoImage.size());
+	logoImage = im;
+	if (relayout)
+		layoutElements();
+	else
+		invalidateStatic(old);
+}
+
+bool ClockCanvas::setText(int e,const QString &txt)
+{
+	TextLayer *l = layer(e);
+	if (l){
+		QRegion dirty = l->showText(txt);
+		update(dirty);
+		return !dirty.isEmpty();
+	}
+	if (statics[e].text == txt) return false; // only repaint when the banner etc actually changes
+	statics[e].text=txt;
+	invalidateStatic(statics[e].rect);
+	return true;
+}
+
+QString ClockCanvas::text(int e)
+{
+	TextLayer *l = layer(e);
+	if (l) return l->text();
+	return statics[e].text;
+}
+
+void ClockCanvas::setTextVisible(int e,bool visible)
+{
+	if (layer(e) || statics[e].visible == visible) return;
+	statics[e].visible=visible;
+	layoutElements();
+}
+
+void ClockCanvas::setFont(int e,const QFont &f)
+{
+	TextLayer *l = layer(e);
+	if (l)
+		l->setFont(f);
+	else
+		statics[e].font=f;
+	layoutElements();
+}
+
+QFont ClockCanvas::font(int e)
+{
+	TextLayer *l = layer(e);
+	if (l) return l->font();
+	return statics[e].font;
+}
+
+void ClockCanvas::setTextColour(const QColor &c)
+{
+	bool changed=false;
+	for (int e=0;e<NElements;e++){
+		TextLayer *l = layer(e);
+		if (l){
+			changed = changed || (l->colour() != c);
+			l->setColour(c);
+		}
+		else{
+			changed = changed || (statics[e].colour != c);
+			statics[e].colour=c;
+		}
+	}
+	panelColour=c;
+	for (int i=0;i<rows.size();i++){
+		changed = changed || (rows.at(i)->colour() != c) || (rowLabels.at(i).colour != c);
+		rows.at(i)->setColour(c);
+		rowLabels[i].colour=c;
+	}
+	if (!changed) return;
+	tod.refresh();
+	date.refresh();
+	for (int i=0;i<rows.size();i++)
+		rows.at(i)->refresh();
+	invalidateStatic(rect()); // one repaint for the lot
+}
+
+void ClockCanvas::setTextColour(int e,const QColor &c)
+{
+	TextLayer *l = layer(e);
+	if (l){
+		if (l->colour() == c) return;
+		l->setColour(c);
+		update(l->refresh());
+		return;
+	}
+	if (statics[e].colour == c) return;
+	statics[e].colour=c;
+	invalidateStatic(statics[e].rect);
+}
+
+QRect ClockCanvas::elementRect(int e)
+{
+	TextLayer *l = layer(e);
+	if (l) return l->geometry();
+	return statics[e].rect;
+}
+
+void ClockCanvas::setPanel(const QStringList &labels,int columns)
+{
+	columns = qMax(1,columns);
+	bool same = (labels.size() == rowLabels.size() && columns == panelColumns);
+	for (int i=0;same && i<labels.size();i++)
+		same = (labels.at(i) == rowLabels.at(i).text);
+	if (same) return;
+	
+	qDeleteAll(rows);
+	rows.clear();
+	rowLabels.clear();
+	panelColumns=columns;
+	for (int i=0;i<labels.size();i++){
+		TextLayer *l = new TextLayer();
+		l->setFont(rowFont);
+		l->setColour(panelColour);
+		l->setAlignment(Qt::AlignLeft | Qt::AlignVCenter); // so that the reading doesn't shuffle sideways
+		l->setPrerendering(prerendering);
+		l->setGlyphAtlas(glyphAtlas);
+		rows.append(l);
+		StaticText label;
+		label.text=labels.at(i);
+		label.font=rowFont;
+		label.colour=panelColour;
+		label.alignment=Qt::AlignRight | Qt::AlignVCenter;
+		rowLabels.append(label);
+	}
+	layoutElements();
+}
+
+QRect ClockCanvas::panelRect()
+{
+	return panelArea;
+}
+
+void ClockCanvas::setPanelColour(const QColor &c)
+{
+	if (panelColour == c) return;
+	panelColour=c;
+	for (int i=0;i<rows.size();i++){
+		rows.at(i)->setColour(c);
+		rowLabels[i].colour=c;
+		update(rows.at(i)->refresh());
+	}
+	invalidateStatic(panelArea); // for the labels
+}
+
+int ClockCanvas::panelRows()
+{
+	return rows.size();
+}
+
+bool ClockCanvas::setPanelText(int row,const QString &txt)
+{
+	if (row < 0 || row >= rows.size()) return false;
+	QRegion dirty = rows.at(row)->showText(txt);
+	update(dirty);
+	return !dirty.isEmpty();
+}
+
+void ClockCanvas::setPanelFont(const QFont &f)
+{
+	if (f == rowFont) return;
+	rowFont=f;
+	for (int i=0;i<rows.size();i++){
+		rows.at(i)->setFont(f);
+		rowLabels[i].font=f;
+	}
+	layoutElements();
+}
+
+QFont ClockCanvas::panelFont()
+{
+	return rowFont;
+}
+
+void ClockCanvas::setPrerendering(bool en)
+{
+	prerendering=en;
+	tod.setPrerendering(en);
+	date.setPrerendering(en);
+	for (int i=0;i<rows.size();i++)
+		rows.at(i)->setPrerendering(en);
+}
+
+void ClockCanvas::setGlyphAtlas(bool en)
+{
+	glyphAtlas=en;
+	tod.setGlyphAtlas(en);
+	update(tod.refresh());
+	for (int i=0;i<rows.size();i++){
+		rows.at(i)->setGlyphAtlas(en);
+		update(rows.at(i)->refresh());
+	}
+}
+
+void ClockCanvas::prerender(int e,const QString &txt)
+{
+	TextLayer *l = layer(e);
+	if (l) l->prerender(txt);
+}
+
+void ClockCanvas::prerenderPanel(int row,const QString &txt)
+{
+	if (row >= 0 && row < rows.size())
+		rows.at(row)->prerender(txt);
+}
+
+//
+//
+//
+
+void ClockCanvas::paintEvent(QPaintEvent *ev)
+{
+	if (staticDirty)
+		rebuildStatic();
+	
+	QPainter p(this);
+	QVector<QRect> rects = ev->region().rects();
+	p.setCompositionMode(QPainter::CompositionMode_Source);
+	for (int i=0;i<rects.size();i++)
+		p.drawImage(rects.at(i),staticLayer,rects.at(i));
+	p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+	
+	p.setClipRegion(ev->region());
+	tod.draw(p);
+	date.draw(p);
+	for (int i=0;i<rows.size();i++)
+		rows.at(i)->draw(p);
+}
+
+void ClockCanvas::resizeEvent(QResizeEvent *ev)
+{
+	QWidget::resizeEvent(ev);
+	layoutElements();
+}
+
+TextLayer * ClockCanvas::layer(int e)
+{
+	switch (e){
+		case TOD: return &tod;
+		case Date: return &date;
+	}
+	return NULL;
+}
+
+void ClockCanvas::layoutElements()
+{
+	// Rows have their natural height, and any space left over is shared between the title, time and date, 
+	// much as the old stack of layouts did
+	int w = width();
+	
+	int titleH = QFontMetrics(statics[Title].font).height();
+	int todH   = QFontMetrics(tod.font()).height() + 2*TODMARGIN;
+	int rowH   = QFontMetrics(rowFont).height();
+	int panelRowCount = (rows.size() + panelColumns - 1)/panelColumns;
+	int panelH = panelRowCount*rowH;
+	int calH   = (statics[CalText].visible ? QFontMetrics(statics[CalText].font).height() : 0);
+	int dateH  = QFontMetrics(date.font()).height();
+	if (!logoImage.isNull() && logoImage.height() + 2*LOGOMARGIN > dateH)
+		dateH = logoImage.height() + 2*LOGOMARGIN;
+	int infoH  = (statics[ImageInfo].visible ? QFontMetrics(statics[ImageInfo].font).height() + CREDITBOTTOM : 0);
+	
+	int extra = height() - (titleH + todH + panelH + calH + dateH + infoH);
+	if (extra > 0){
+		titleH += extra/3;
+		todH   += extra/3;
+		dateH  += extra - 2*(extra/3);
+	}
+	
+	int y=0;
+	statics[Title].rect = QRect(0,y,w,titleH);
+	y += titleH;
+	tod.setGeometry(QRect(0,y+TODMARGIN,w,todH-2*TODMARGIN));
+	y += todH;
+	panelArea = QRect(0,y,w,panelH);
+	int cellW = w/panelColumns;
+	for (int i=0;i<rows.size();i++){ // down each column in turn
+		int x = (i/panelRowCount)*cellW;
+		int cy = y + (i % panelRowCount)*rowH;
+		rowLabels[i].rect = QRect(x,cy,cellW/2 - ROWGAP/2,rowH);
+		rows.at(i)->setGeometry(QRect(x + cellW/2 + ROWGAP/2,cy,cellW - cellW/2 - ROWGAP/2,rowH));
+	}
+	y += panelH;
+	statics[CalText].rect = QRect(0,y,w,calH);
+	y += calH;
+	date.setGeometry(QRect(0,y,w,dateH));
+	logoPos = QPoint(LOGOMARGIN,y+LOGOMARGIN);
+	y += dateH;
+	statics[ImageInfo].rect = QRect(CREDITMARGIN,y,w-2*CREDITMARGIN,infoH-CREDITBOTTOM);
+	
+	tod.refresh();
+	date.refresh();
+	for (int i=0;i<rows.size();i++)
+		rows.at(i)->refresh();
+	invalidateStatic(rect());
+}
+
+void ClockCanvas::invalidateStatic(const QRect &r)
+{
+	staticDirty=true;
+	update(r);
+}
+
+void ClockCanvas::rebuildStatic()
+{
+	staticDirty=false;
+	
+	if (staticLayer.size() != size())
+		staticLayer = QImage(size(),QImage::Format_ARGB32_Premultiplied);
+	
+	QPainter p(&staticLayer);
+	if (bkImage.isNull() || bkImage.hasAlphaChannel() || bkImage.size() != size())
+		p.fillRect(staticLayer.rect(),bkImage.isNull() ? bkColour : QColor(Qt::black));
+	if (!bkImage.isNull())
+		p.drawImage(backgroundRect().topLeft(),bkImage);
+	if (!logoImage.isNull())
+		p.drawImage(logoPos,logoImage);
+	
+	for (int e=0;e<NElements;e++){
+		if (layer(e) || !statics[e].visible || statics[e].text.isEmpty()) continue;
+		p.setFont(statics[e].font);
+		p.setPen(statics[e].colour);
+		p.drawText(statics[e].rect,statics[e].alignment,statics[e].text);
+	}
+	for (int i=0;i<rowLabels.size();i++){
+		const StaticText &label = rowLabels.at(i);
+		p.setFont(label.font);
+		p.setPen(label.colour);
+		p.drawText(label.rect,label.alignment,label.text);
+	}
+}
@@ -0,0 +1,140 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __CLOCK_CANVAS_H_
+#define __CLOCK_CANVAS_H_
+
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QList>
+#include <QPoint>
+#include <QRect>
+#include <QString>
+#include <QStringList>
+#include <QWidget>
+
+#include "TextLayer.h"
+
+class QPaintEvent;
+class QResizeEvent;
+
+// The whole clock face, painted by one widget.
+// Everything that changes rarely (background, logo, banner, calendar text, image credit) is flattened
+// into a single premultiplied ARGB image. The time of day and date are TextLayers blitted over it.
+// Element geometry is only computed when the widget is resized or a font or visibility changes.
+//
+// The layout, top to bottom, is
+//   title (banner)
+//   time of day
+//   the panel, if there is one: a grid of labelled readings of other time scales and zones, filled by columns
+//   calendar text
+//   date, with the logo at its top left
+//   image credit
+
+class ClockCanvas : public QWidget
+{
+	Q_OBJECT
+	
+	public:
+	
+		enum Element {Title,TOD,CalText,Date,ImageInfo,NElements};
+		
+		ClockCanvas(QWidget *parent=NULL);
+		~ClockCanvas();
+		
+		void setBackground(const QImage &);
+		QImage background();
+		QRect backgroundRect(); // where the background image is drawn
+		void setBackgroundColour(const QColor &); // used when there is no image
+		void setLogo(const QImage &);
+		
+		bool setText(int,const QString &); // whether a repaint was scheduled
+		QString text(int);
+		void setTextVisible(int,bool);
+		void setFont(int,const QFont &);
+		QFont font(int);
+		void setTextColour(const QColor &);
+		void setTextColour(int,const QColor &);
+		QRect elementRect(int);
+		
+		void setPanel(const QStringList &,int columns=1); // a cell for each label; none turns the panel off
+		int  panelRows();
+		bool setPanelText(int,const QString &); // likewise
+		void setPanelFont(const QFont &);     // the labels and readings share it
+		QFont panelFont();
+		void setPanelColour(const QColor &);  // and this
+		QRect panelRect();
+		
+		void setPrerendering(bool);
+		void setGlyphAtlas(bool);
+		void prerender(int,const QString &);
+		void prerenderPanel(int,const QString &);
+		
+	protected:
+	
+		virtual void paintEvent(QPaintEvent *);
+		virtual void resizeEvent(QResizeEvent *);
+		
+	private:
+	
+		class StaticText
+		{
+			public:
+				StaticText(){alignment=Qt::AlignCenter;visible=true;}
+				QString text;
+				QFont font;
+				QColor colour;
+				QRect rect;
+				int alignment;
+				bool visible;
+		};
+		
+		TextLayer *layer(int);
+		void layoutElements();
+		void invalidateStatic(const QRect &);
+		void rebuildStatic();
+		
+		QColor bkColour;
+		QImage bkImage;
+		QImage logoImage;
+		QPoint logoPos;
+		StaticText statics[NElements]; // only the title, calendar text and image credit
+		
+		QImage staticLayer;
+		bool staticDirty;
+		
+		TextLayer tod,date;
+		
+		QList<TextLayer *> rows; // panel readings, a cell at a time
+		QList<StaticText> rowLabels;
+		int panelColumns;
+		QRect panelArea;
+		QFont rowFont;
+		QColor panelColour;
+		bool prerendering,glyphAtlas; // for new rows
+};
+
+#endif
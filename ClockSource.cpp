@@ -0,0 +1,208 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <sys/timex.h>
+#include <time.h>
+
+#include <QMutexLocker>
+
+#include "ClockSource.h"
+
+#define NSPERSEC 1000000000LL
+#define NSPERDAY (86400*NSPERSEC)
+
+static qint64 clockNow(clockid_t clk) // in ns
+{
+	struct timespec ts;
+	clock_gettime(clk,&ts);
+	return (qint64) ts.tv_sec*NSPERSEC + ts.tv_nsec;
+}
+
+//
+// ClockSource
+//
+
+ClockSource::ClockSource(QObject *parent):QObject(parent)
+{
+}
+
+bool ClockSource::isSimulated()
+{
+	return false;
+}
+
+double ClockSource::rate()
+{
+	return 1.0;
+}
+
+qint64 ClockSource::msecs()
+{
+	return now()/1000000;
+}
+
+int ClockSource::taiOffset()
+{
+	return -1;
+}
+
+QDateTime ClockSource::currentDateTime()
+{
+	return QDateTime::fromMSecsSinceEpoch(msecs());
+}
+
+//
+// SystemClock
+//
+
+SystemClock::SystemClock(QObject *parent):ClockSource(parent)
+{
+}
+
+qint64 SystemClock::now()
+{
+	return clockNow(CLOCK_REALTIME);
+}
+
+int SystemClock::leapState()
+{
+	struct timex tx;
+	tx.modes=0;
+	return adjtimex(&tx);
+}
+
+int SystemClock::taiOffset()
+{
+	// The offset that CLOCK_TAI adds to CLOCK_REALTIME. It's zero until ntpd or chrony sets it
+	struct timex tx;
+	tx.modes=0;
+	if (adjtimex(&tx) < 0 || tx.tai <= 0)
+		return -1;
+	return tx.tai;
+}
+
+//
+// SimulatedClock
+//
+
+SimulatedClock::SimulatedClock(qint64 t,double r,QObject *parent):ClockSource(parent)
+{
+	start = t*1000000;
+	realStart = clockNow(CLOCK_MONOTONIC);
+	simRate = (r > 0 ? r : 1.0);
+	leap = 0;
+	tai = -1;
+}
+
+qint64 SimulatedClock::now()
+{
+	QMutexLocker lock(&mutex);
+	// Like the kernel, repeat 23:59:59 for the inserted second
+	qint64 t = elapsed();
+	if (leap && t >= leap)
+		t -= NSPERSEC;
+	return t;
+}
+
+int SimulatedClock::leapState()
+{
+	QMutexLocker lock(&mutex);
+	if (!leap) return TIME_OK;
+	qint64 t = elapsed();
+	if (t < leap - NSPERDAY)
+		return TIME_OK;
+	if (t < leap)
+		return TIME_INS;
+	if (t < leap + NSPERSEC)
+		return TIME_OOP;
+	if (t < leap + NSPERDAY)
+		return TIME_WAIT;
+	return TIME_OK;
+}
+
+int SimulatedClock::taiOffset()
+{
+	QMutexLocker lock(&mutex);
+	if (tai < 0) return -1;
+	// Like the kernel, the offset goes up as the leap second starts
+	return (leap && elapsed() >= leap ? tai+1 : tai);
+}
+
+bool SimulatedClock::isSimulated()
+{
+	return true;
+}
+
+double SimulatedClock::rate()
+{
+	QMutexLocker lock(&mutex);
+	return simRate;
+}
+
+void SimulatedClock::setRate(double r)
+{
+	if (r <= 0) return;
+	mutex.lock();
+	start = elapsed(); // carry on from here
+	realStart = clockNow(CLOCK_MONOTONIC);
+	simRate = r;
+	mutex.unlock();
+	emit stepped();
+}
+
+void SimulatedClock::stepTo(qint64 t)
+{
+	mutex.lock();
+	start = t*1000000;
+	if (leap && start >= leap) // after the leap second, elapsed time is one second ahead of UTC
+		start += NSPERSEC;
+	realStart = clockNow(CLOCK_MONOTONIC);
+	mutex.unlock();
+	emit stepped();
+}
+
+void SimulatedClock::setTAIOffset(int offset)
+{
+	mutex.lock();
+	tai = offset;
+	mutex.unlock();
+}
+
+void SimulatedClock::setLeapSecond(qint64 t)
+{
+	mutex.lock();
+	leap = t*1000000;
+	mutex.unlock();
+	emit stepped();
+}
+
+//
+//
+//
+
+qint64 SimulatedClock::elapsed()
+{
+	return start + (qint64) ((clockNow(CLOCK_MONOTONIC) - realStart)*simRate);
+}
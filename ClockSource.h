@@ -0,0 +1,105 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __CLOCK_SOURCE_H_
+#define __CLOCK_SOURCE_H_
+
+#include <QDateTime>
+#include <QMutex>
+#include <QObject>
+
+// Where every component gets the time from.
+// The SystemClock reads the kernel. The SimulatedClock runs from a chosen instant at a chosen rate, and can
+// insert a leap second, so that rare events (leap seconds, power windows, slideshow and DST changes) can
+// be rehearsed without waiting for them.
+// Clocks are read from both the GUI and housekeeping threads, so implementations must be thread-safe.
+
+class ClockSource : public QObject
+{
+	Q_OBJECT
+	
+	public:
+	
+		ClockSource(QObject *parent=NULL);
+		
+		virtual qint64 now()=0;         // UTC, in ns since the Unix epoch
+		virtual int leapState()=0;      // as returned by adjtimex(), eg TIME_OK, TIME_INS, TIME_OOP
+		virtual int taiOffset();        // TAI-UTC in s, as CLOCK_TAI has it, or -1 if it hasn't been set
+		virtual bool isSimulated();
+		virtual double rate();          // simulated seconds per real second
+		
+		qint64 msecs();                 // now(), in ms
+		QDateTime currentDateTime();    // local time
+		
+	signals:
+	
+		void stepped(); // the clock has jumped, or changed rate, so any pending deadlines are meaningless
+};
+
+class SystemClock : public ClockSource
+{
+	Q_OBJECT
+	
+	public:
+	
+		SystemClock(QObject *parent=NULL);
+		
+		virtual qint64 now();
+		virtual int leapState();
+		virtual int taiOffset();
+};
+
+class SimulatedClock : public ClockSource
+{
+	Q_OBJECT
+	
+	public:
+	
+		SimulatedClock(qint64,double rate=1.0,QObject *parent=NULL); // start, in ms since the Unix epoch
+		
+		virtual qint64 now();
+		virtual int leapState();
+		virtual int taiOffset();
+		virtual bool isSimulated();
+		virtual double rate();
+		
+		void setRate(double);
+		void setTAIOffset(int);  // before any leap second; -1 for unset
+		void stepTo(qint64);     // in ms since the Unix epoch
+		void setLeapSecond(qint64); // a leap second is inserted just before this instant (a UTC midnight), in ms
+		
+	private:
+	
+		qint64 elapsed();  // continuous simulated time, with no leap second, in ns
+		
+		QMutex mutex;
+		qint64 start;      // ns
+		qint64 realStart;  // CLOCK_MONOTONIC, in ns
+		double simRate;
+		qint64 leap;       // ns, or 0 if none
+		int tai;
+};
+
+#endif
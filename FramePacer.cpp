@@ -0,0 +1,70 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "FramePacer.h"
+
+FramePacer::FramePacer()
+{
+	budget=1000000;
+	totalMissed=0;
+	reset();
+}
+
+void FramePacer::setPeriod(int ms)
+{
+	budget=ms*1000;
+	reset();
+}
+
+int FramePacer::period()
+{
+	return budget/1000;
+}
+
+bool FramePacer::record(qint64 latency)
+{
+	frames++;
+	if (latency > budget){
+		misses++;
+		totalMissed++;
+	}
+	if (misses >= MaxMisses){
+		reset();
+		return true;
+	}
+	if (frames >= Window)
+		reset();
+	return false;
+}
+
+void FramePacer::reset()
+{
+	frames=misses=0;
+}
+
+int FramePacer::missed()
+{
+	return totalMissed;
+}
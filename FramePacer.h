@@ -0,0 +1,58 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __FRAME_PACER_H_
+#define __FRAME_PACER_H_
+
+#include <QtGlobal>
+
+// Keeps track of whether sub-second frames are making their budget: a frame that is painted later than
+// one frame period after its deadline has been missed, since the next one was already due.
+// When too many frames in a window are missed, the display should fall back to a coarser resolution.
+
+class FramePacer
+{
+	public:
+	
+		enum {Window=50,MaxMisses=5}; // in frames
+		
+		FramePacer();
+		
+		void setPeriod(int); // the frame budget, in ms
+		int period();
+		
+		bool record(qint64); // paint latency in us; true if it is time to fall back
+		void reset();
+		
+		int missed(); // in total
+		
+	private:
+	
+		int budget; // in us
+		int frames,misses;
+		int totalMissed;
+};
+
+#endif
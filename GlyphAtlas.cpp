@@ -0,0 +1,156 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <QFontMetrics>
+#include <QPainter>
+
+#include "GlyphAtlas.h"
+
+// Everything that showTime() can produce
+static const char glyphs[]="0123456789: s-."; // in cell order, NGlyphs of them
+
+GlyphAtlas::GlyphAtlas()
+{
+	ascent=height=pad=0;
+	for (int i=0;i<NGlyphs;i++)
+		advances[i]=0;
+}
+
+bool GlyphAtlas::covers(const QString &txt)
+{
+	for (int i=0;i<txt.length();i++){
+		if (cellIndex(txt.at(i)) < 0) return false;
+	}
+	return true;
+}
+
+bool GlyphAtlas::matches(const QFont &f,const QColor &c)
+{
+	return !atlas.isNull() && f == font && c == colour;
+}
+
+void GlyphAtlas::rebuild(const QFont &f,const QColor &c)
+{
+	font=f;
+	colour=c;
+	
+	QFontMetrics fm(font);
+	ascent=fm.ascent();
+	height=fm.height();
+	pad = height/8; // room for glyphs which overhang their advance
+	
+	int x=0;
+	for (int i=0;i<NGlyphs;i++){
+		advances[i]=fm.width(QLatin1Char(glyphs[i]));
+		cells[i]=QRect(x,0,advances[i]+2*pad,height);
+		x += cells[i].width();
+	}
+	
+	atlas = QImage(x,height,QImage::Format_ARGB32_Premultiplied);
+	atlas.fill(0); // transparent
+	QPainter p(&atlas);
+	p.setFont(font);
+	p.setPen(colour);
+	for (int i=0;i<NGlyphs;i++)
+		p.drawText(cells[i].left()+pad,ascent,QString(QLatin1Char(glyphs[i])));
+}
+
+void GlyphAtlas::draw(QPainter &p,const QRect &r,int alignment,const QString &txt)
+{
+	QPoint o = origin(r,alignment,txt);
+	int x = o.x();
+	int y = o.y();
+	
+	for (int i=0;i<txt.length();i++){
+		int c = cellIndex(txt.at(i));
+		if (txt.at(i) != ' ')
+			p.drawImage(x-pad,y,atlas,cells[c].left(),cells[c].top(),cells[c].width(),cells[c].height());
+		x += advances[c];
+	}
+}
+
+QRegion GlyphAtlas::changed(const QRect &r,int alignment,const QString &from,const QString &to)
+{
+	// If the layout is different (eg 9:59:59 to 10:00:00 in 12 hour format), then everything has changed
+	if (!covers(from) || !covers(to) || from.length() != to.length() || textWidth(from) != textWidth(to))
+		return QRegion(r);
+	
+	QRegion rgn;
+	QPoint o = origin(r,alignment,to);
+	int x = o.x();
+	for (int i=0;i<to.length();i++){
+		int adv = advances[cellIndex(to.at(i))];
+		if (from.at(i) != to.at(i))
+			rgn += QRect(x-pad,o.y(),adv+2*pad,height); // including any overhang
+		x += adv;
+	}
+	return rgn.intersected(r);
+}
+
+//
+//
+//
+
+int GlyphAtlas::textWidth(const QString &txt)
+{
+	int w=0;
+	for (int i=0;i<txt.length();i++)
+		w += advances[cellIndex(txt.at(i))];
+	return w;
+}
+
+QPoint GlyphAtlas::origin(const QRect &r,int alignment,const QString &txt)
+{
+	// top left of the first cell, as QPainter::drawText() would lay it out
+	int w = textWidth(txt);
+	
+	int x = r.left();
+	if (alignment & Qt::AlignHCenter)
+		x += (r.width()-w)/2;
+	else if (alignment & Qt::AlignRight)
+		x += r.width()-w;
+	
+	int y = r.top();
+	if (alignment & Qt::AlignVCenter)
+		y += (r.height()-height)/2;
+	else if (alignment & Qt::AlignBottom)
+		y += r.height()-height;
+	
+	return QPoint(x,y);
+}
+
+int GlyphAtlas::cellIndex(QChar c)
+{
+	char ch = c.toLatin1();
+	if (ch >= '0' && ch <= '9') return ch-'0';
+	switch (ch){
+		case ':': return 10;
+		case ' ': return 11;
+		case 's': return 12;
+		case '-': return 13;
+		case '.': return 14;
+	}
+	return -1;
+}
@@ -0,0 +1,71 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __GLYPH_ATLAS_H_
+#define __GLYPH_ATLAS_H_
+
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QRect>
+#include <QRegion>
+#include <QString>
+
+class QPainter;
+
+// Pre-rasterised time of day glyphs at one font and colour.
+// Drawing a string from the atlas is just a copy per character, instead of shaping and rasterising
+// glyphs which may be hundreds of points high.
+
+class GlyphAtlas
+{
+	public:
+	
+		enum {NGlyphs=15}; // digits, ':', ' ', 's', '-' and '.'
+		
+		GlyphAtlas();
+		
+		bool covers(const QString &);  // true if every character is in the atlas
+		bool matches(const QFont &,const QColor &);
+		void rebuild(const QFont &,const QColor &);
+		
+		void draw(QPainter &,const QRect &,int,const QString &); // drawn within the rectangle, with the given alignment
+		QRegion changed(const QRect &,int,const QString &,const QString &); // the cells that differ between two strings
+		
+	private:
+	
+		int cellIndex(QChar);
+		int textWidth(const QString &);
+		QPoint origin(const QRect &,int,const QString &);
+		
+		QFont font;
+		QColor colour;
+		QImage atlas; // premultiplied ARGB
+		int ascent,height,pad;
+		QRect cells[NGlyphs];
+		int advances[NGlyphs];
+};
+
+#endif
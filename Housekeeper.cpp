@@ -0,0 +1,396 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include "ClockSource.h"
+#include "Housekeeper.h"
+#include "LeapFetcher.h"
+#include "LeapFile.h"
+#include "PowerManager.h"
+
+#define MINLEAPCHECKINTERVAL 8       // in s
+#define MAXLEAPCHECKINTERVAL 1048576 // two weeks should be good enough
+
+HousekeeperConfig::HousekeeperConfig()
+{
+	backgroundMode=TimeDisplay::Fixed;
+	slideshowPeriod=1;
+	dimEnable=false;
+	dimLevel=25;
+	forceBackground=false;
+	dimThreshold=0;
+	autoUpdateLeapFile=false;
+}
+
+Housekeeper::Housekeeper(ClockSource *c,PowerManager *pm):QObject()
+{
+	qRegisterMetaType<HousekeeperConfig>("HousekeeperConfig");
+	qRegisterMetaType<LuminanceTable>("LuminanceTable");
+	
+	clock=c;
+	powerManager=pm;
+	
+	leapSeconds=-1; // so that the first value read is posted
+	leapsInitialized=false;
+	leapFileExpiry= QDateTime(QDate(1970,1,1),QTime(0,0,0));
+	nextLeapFileFetch=leapFileExpiry;
+	leapFetchAttempts=0;
+}
+
+void Housekeeper::requestUpdate(const QDateTime &now)
+{
+	// If the last request hasn't been handled yet (eg a big image is being loaded), don't queue up another
+	if (pending.testAndSetRelaxed(0,1))
+		QMetaObject::invokeMethod(this,"update",Qt::QueuedConnection,Q_ARG(QDateTime,now));
+}
+
+QString Housekeeper::pickCalendarImage(const QList<CalendarItem> &calendarItems,const QDate &today,QString &description)
+{
+	QString res="";
+	
+	for (int i=0;i<calendarItems.length();++i){
+		const CalendarItem &ci = calendarItems.at(i);
+		// calculations are easiest if we make QDates using the current year
+		QDate start(today.year(),ci.startMonth,ci.startDay);
+		QDate stop(today.year(),ci.stopMonth,ci.stopDay);
+		// Take care here with leap years - presumably specifying Feb 29 on a non-leap year results in an invalid date
+		if (start.isValid() && stop.isValid() && stop >= start){
+			if (today >= start && today <= stop){
+				qDebug() << "Picked calendar image" << ci.image;
+				QFileInfo fi = QFileInfo(ci.image);
+				if (fi.exists()){
+					res = ci.image;
+					description=ci.description;
+				}
+				else
+					res="";
+				return res;
+			}
+		}
+	}
+	
+	return res;
+}
+
+//
+// Public slots - these all run on the housekeeping thread
+//
+
+void Housekeeper::configure(HousekeeperConfig c)
+{
+	bool leapFileChanged = (c.leapFile != cfg.leapFile) || (c.autoUpdateLeapFile != cfg.autoUpdateLeapFile);
+	cfg=c;
+	if (leapFileChanged)
+		leapsInitialized=false;
+	
+	if (cfg.forceBackground){
+		QDateTime now = clock->currentDateTime();
+		updateBackgroundImage(now,true);
+	}
+}
+
+void Housekeeper::update(QDateTime now)
+{
+	pending.fetchAndStoreRelaxed(0);
+	
+	updateLeapSeconds(now);
+	powerManager->update();
+	updateBackgroundImage(now,false);
+	if (cfg.dimEnable) readLightLevel();
+	checkConfigFile();
+}
+
+void Housekeeper::updateLeapSeconds(QDateTime now)
+{
+	
+	// If just starting then we need to read the leap file
+	//    If we don't have it then we need to fetch it
+	//    If we have it then read it
+	
+	// If the file has already been read, then we need to check
+	// expiry and fetch a new file
+	//
+	
+	if (cfg.autoUpdateLeapFile){
+		if (!leapsInitialized){
+			QFileInfo fi(cfg.leapFile);
+			if (fi.exists()){// Have we got a cached leap second list ?
+				if (fi.lastModified() == leapFileLastModified){ // already rejected, so wait for a good one
+					fetchLeapSeconds(now);
+					return;
+				}
+				readLeapFile(now);
+				if (leapFileExpiry.secsTo(now) > 0){ // time to look for a new one
+					qDebug() << "the leap file has expired";
+					fetchLeapSeconds(now);
+				}
+			}
+			else{
+				qDebug() << "no cached leap second file";
+				fetchLeapSeconds(now); // not cached so try to get one
+			}
+		}
+		else{ // we have a file, so check it out ...
+			if (leapFileExpiry.secsTo(now) > 0){
+				fetchLeapSeconds(now);
+			}
+			else{ // have an up to date file so extract the current leap value
+				setLeapSeconds(now);
+			}
+		}
+	}
+	else{ // using a system-supplied leap second file
+		if (!leapsInitialized){
+			// Have we got a leap second list 
+			QFileInfo fi(cfg.leapFile);
+			if (fi.exists()){
+				if (fi.lastModified() == leapFileLastModified){
+					qDebug() << "leap file still out of date";
+					return;
+				}
+				readLeapFile(now);
+				if (leapFileExpiry.secsTo(now) > 0) // out of date
+					leapsInitialized=false;
+			}
+		}
+		else
+			setLeapSeconds(now);
+	}
+	
+}
+
+void Housekeeper::leapFileFetched(int result)
+{
+	QDateTime now = clock->currentDateTime();
+	if (result == LeapFetcher::Updated)
+		readLeapFile(now);
+	if (leapsInitialized && leapFileExpiry > now) // done until this one expires
+		leapFetchAttempts=0;
+}
+
+void Housekeeper::deviceEvent()
+{
+	powerManager->deviceEvent();
+}
+
+//
+//
+//
+
+void Housekeeper::updateBackgroundImage(QDateTime &now,bool force)
+{
+	
+	bool updateImage=force;
+	
+	if (force){
+		qDebug() << "Forcing image update";
+		currentImage=cfg.defaultImage; // if a calendar item has become inactive, then this (and the next line) puts us in the right state
+		if (cfg.backgroundMode == TimeDisplay::Slideshow)
+			setBackgroundFromSlideShow(now);
+		setBackgroundFromCalendar(now); // this overrides everything
+	}
+	else{ // determine whether the backgound image must be updated
+		QString im=currentImage;
+		if (cfg.backgroundMode==TimeDisplay::Fixed)
+			currentImage=cfg.defaultImage;
+		if (cfg.backgroundMode == TimeDisplay::Slideshow && (now > nextSlideUpdate)){
+			setBackgroundFromSlideShow(now);
+		}
+		setBackgroundFromCalendar(now);
+		updateImage = (im != currentImage);
+	}
+	
+	if (!updateImage) return;
+	
+	QImage image,dimImage;
+	LuminanceTable lum;
+	QString info;
+	if (!currentImage.isEmpty()){
+		image = QImage(currentImage);
+		lum.build(image); // before the display converts it, and even if it isn't used yet, in case the config changes
+		if (cfg.dimEnable){
+			dimImage = dimmed(image,cfg.dimLevel); // calculate and cache the dimmed image
+		}
+		info = makeImageInfo(currentImage);
+	}
+	
+	emit backgroundChanged(currentImage,image,dimImage,lum,calItemText,info);
+}
+
+QImage Housekeeper::dimmed(const QImage &image,int level)
+{
+	QImage dim = image.convertToFormat(QImage::Format_RGB32);
+	for (int i=0;i<dim.width();i++){
+		for (int j=0;j<dim.height();j++){
+			QColor col = QColor(dim.pixel(i,j));
+			QColor newcol = col.darker((int)(100*100/level));
+			QRgb val = newcol.rgb();
+			dim.setPixel(i,j,val);
+		}
+	}
+	return dim;
+}
+
+void Housekeeper::setBackgroundFromCalendar(QDateTime &now)
+{
+	calItemText="";
+	QString im = pickCalendarImage(cfg.calendarItems,now.date(),calItemText);
+	if (!im.isEmpty())
+		currentImage=im;
+}
+
+void Housekeeper::setBackgroundFromSlideShow(QDateTime &now)
+{
+	currentImage=pickSlideShowImage();
+	nextSlideUpdate=now;
+	int secs = nextSlideUpdate.time().minute()*60 +  nextSlideUpdate.time().second();
+	nextSlideUpdate=nextSlideUpdate.addSecs(3600*cfg.slideshowPeriod-secs);
+}
+
+QString Housekeeper::pickSlideShowImage()
+{
+	QString res="";
+	QDir imPath(cfg.imagePath);
+	if (!imPath.exists()) return res;
+	
+	QStringList filters;
+	filters << "*.png" << "*.jpeg" << "*.jpg" << "*.tiff" << "*.bmp";
+	QFileInfoList imList=imPath.entryInfoList(filters,QDir::Files|QDir::Readable);
+	if (imList.length()==0) return res;
+	
+	int r = trunc(imList.length()*(double) (random())/(double) (RAND_MAX));
+	if (r==imList.length()) r=imList.length()-1;
+	res= imList.at(r).absoluteFilePath();
+	qDebug() << "Picked slide show image " << res;
+	return res;
+}
+
+QString Housekeeper::makeImageInfo(QString &fname)
+{
+	// Parses the image filename into a formatted string
+	// The image file name should be in the format AUTHOR__TITLE__whatever
+	// Anything before the first separator is taken to be the AUTHOR
+	// If the second separator is missing, then the title is left blank
+	QString info="";
+	QFileInfo fi(fname);
+	QStringList tmp=fi.baseName().split("__");
+	qDebug() << tmp;
+	if (2==tmp.size()){ // Author only
+		info=tmp.at(0);
+	}
+	else if (3==tmp.size()){
+		info=tmp.at(0)+" - "+tmp.at(1);
+	}
+	qDebug() << info;
+	return info;
+}
+
+void Housekeeper::readLightLevel()
+{
+	// Check the sensor reading
+	QFile lf(cfg.lightLevelFile);
+	if (lf.open(QFile::ReadOnly)){
+		QTextStream ts(&lf);
+		int currLightLevel=255;
+		ts >> currLightLevel;
+		if (ts.status() == QTextStream::Ok)
+			emit lightLevelRead(currLightLevel < cfg.dimThreshold);
+	}
+}
+
+void Housekeeper::checkConfigFile()
+{
+	if (cfg.configFile.isEmpty()) return;
+	QFileInfo fi = QFileInfo(cfg.configFile);
+	if (fi.lastModified() != configLastModified){ // the GUI decides whether it's actually newer
+		configLastModified = fi.lastModified();
+		emit configFileModified(configLastModified);
+	}
+}
+
+void Housekeeper::fetchLeapSeconds(QDateTime &now)
+{
+	if (now < nextLeapFileFetch) return;
+	qDebug() << "fetching leap second file " << cfg.leapFileURL ;
+	emit fetchLeapFile(cfg.leapFileURL,cfg.leapFile);
+	leapFetchAttempts++;
+	nextLeapFileFetch = now.addSecs(leapFetchBackoff(leapFetchAttempts));
+}
+
+int Housekeeper::leapFetchBackoff(int attempts)
+{
+	// Exponential, with jitter so that a lot of clocks restarted together don't stay in step
+	int interval=MINLEAPCHECKINTERVAL;
+	for (int i=1;i<attempts && interval < MAXLEAPCHECKINTERVAL;i++)
+		interval *= 2;
+	if (interval > MAXLEAPCHECKINTERVAL)
+		interval = MAXLEAPCHECKINTERVAL;
+	return interval/2 + random() % (interval/2 + 1);
+}
+
+void Housekeeper::readLeapFile(QDateTime &now)
+{
+
+	qDebug() << "reading leap seconds file " << cfg.leapFile;
+	
+	QFileInfo fi(cfg.leapFile);
+	leapFileLastModified=fi.lastModified(); // even if it's bad, so that it isn't read again until it changes
+	
+	LeapFile lf;
+	if (!lf.read(cfg.leapFile)){
+		qWarning() << "rejected leap seconds file " << cfg.leapFile << ": " << lf.error();
+		return;
+	}
+	
+	leapTable = lf.table();
+	leapFileExpiry.setTime_t(lf.expires() - UNIXEPOCH);
+	qDebug() << "leap second file expiry time " << leapFileExpiry;
+	
+	setLeapSeconds(now);
+	
+	leapsInitialized=true;
+	
+}
+
+void Housekeeper::setLeapSeconds(QDateTime &now)
+{
+	// One comparison, unless a leap has just passed or the table has been reloaded
+	int dt = leapTable.current(now.toTime_t());
+	if (dt < 0) return; // before the table starts
+	int ls = dt - DELTATAIGPS;
+	if (ls != leapSeconds){
+		leapSeconds = ls;
+		qDebug() << "delta_TAI= " << dt << " ls =" << leapSeconds;
+		emit leapSecondsChanged(leapSeconds);
+	}
+}
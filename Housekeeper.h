@@ -0,0 +1,145 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __HOUSEKEEPER_H_
+#define __HOUSEKEEPER_H_
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QImage>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+
+#include "LeapTable.h"
+#include "LuminanceTable.h"
+#include "TimeDisplay.h"
+
+class ClockSource;
+class PowerManager;
+
+// The part of the configuration that the housekeeping jobs need.
+// A copy is handed to the Housekeeper whenever the configuration is (re)read.
+
+class HousekeeperConfig
+{
+	public:
+	
+		HousekeeperConfig();
+		
+		QString configFile;
+		
+		// background
+		QString defaultImage;
+		int backgroundMode;
+		QString imagePath;
+		int slideshowPeriod;
+		QList<CalendarItem> calendarItems;
+		bool dimEnable;
+		int dimLevel;
+		bool forceBackground;
+		
+		// light level
+		QString lightLevelFile;
+		int dimThreshold;
+		
+		// leap seconds
+		bool autoUpdateLeapFile;
+		QString leapFile;
+		QString leapFileURL;
+};
+
+Q_DECLARE_METATYPE(HousekeeperConfig)
+
+// Runs the slow, once-per-second jobs (leap second file, power management, background image,
+// light level, configuration file) on its own thread, and posts only the results back to the GUI thread.
+
+class Housekeeper : public QObject
+{
+	Q_OBJECT
+	
+	public:
+	
+		Housekeeper(ClockSource *,PowerManager *);
+		
+		void requestUpdate(const QDateTime &); // call from the GUI thread
+		
+		static QString pickCalendarImage(const QList<CalendarItem> &,const QDate &,QString &);
+		static QImage dimmed(const QImage &,int);
+		
+	public slots:
+	
+		void configure(HousekeeperConfig);
+		void update(QDateTime);
+		void updateLeapSeconds(QDateTime);
+		void leapFileFetched(int); // a LeapFetcher::Result
+		void deviceEvent();
+		
+	signals:
+	
+		void backgroundChanged(QString,QImage,QImage,LuminanceTable,QString,QString); // file, image, dimmed image, its luminance, calendar text, image info
+		void lightLevelRead(bool); // true if low light
+		void configFileModified(QDateTime);
+		void leapSecondsChanged(int);
+		void fetchLeapFile(QString,QString); // URL, file
+		
+	private:
+	
+		void updateBackgroundImage(QDateTime &,bool);
+		void setBackgroundFromCalendar(QDateTime &);
+		void setBackgroundFromSlideShow(QDateTime &);
+		QString pickSlideShowImage();
+		QString makeImageInfo(QString &);
+		
+		void readLightLevel();
+		void checkConfigFile();
+		
+		void fetchLeapSeconds(QDateTime &);
+		void readLeapFile(QDateTime &);
+		void setLeapSeconds(QDateTime &);
+		static int leapFetchBackoff(int);
+		
+		ClockSource *clock;
+		PowerManager *powerManager;
+		HousekeeperConfig cfg;
+		QAtomicInt pending;
+		
+		QString currentImage;
+		QString calItemText;
+		QDateTime nextSlideUpdate;
+		
+		QDateTime configLastModified;
+		
+		int leapSeconds;
+		QDateTime leapFileExpiry;
+		QDateTime nextLeapFileFetch;
+		QDateTime leapFileLastModified;
+		int leapFetchAttempts; // since the last good file
+		bool leapsInitialized;
+		LeapTable leapTable;
+};
+
+#endif
@@ -0,0 +1,207 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <QDebug>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QUrl>
+
+#include "LeapFetcher.h"
+#include "LeapFile.h"
+
+LeapFetcher::LeapFetcher(QObject *parent):QObject(parent)
+{
+	timeout=Timeout;
+	timer.setSingleShot(true);
+	connect(&timer,SIGNAL(timeout()),this,SLOT(timedOut()));
+}
+
+void LeapFetcher::fetch(QNetworkAccessManager *nam,const QString &url,const QString &file)
+{
+	if (busy()){
+		qDebug() << "LeapFetcher: still fetching";
+		return;
+	}
+	
+	target=file;
+	QNetworkRequest req((QUrl(url)));
+	
+	// Only ask for changes if what we have is good; otherwise get the whole file
+	LeapFile cached;
+	if (cached.read(file)){
+		QFile vf(validatorFile(file));
+		if (vf.open(QIODevice::ReadOnly | QIODevice::Text)){
+			while (!vf.atEnd()){
+				QByteArray line = vf.readLine();
+				int colon = line.indexOf(':');
+				if (colon <= 0) continue;
+				QByteArray name = line.left(colon).trimmed();
+				QByteArray val = line.mid(colon+1).trimmed();
+				if (name == "ETag")
+					req.setRawHeader("If-None-Match",val);
+				else if (name == "Last-Modified")
+					req.setRawHeader("If-Modified-Since",val);
+			}
+		}
+	}
+	
+	part.setFileName(file + ".part");
+	if (!part.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+		qWarning() << "LeapFetcher: can't write " << part.fileName();
+		emit fetched(Failed);
+		return;
+	}
+	
+	qDebug() << "LeapFetcher: fetching " << url;
+	reply = nam->get(req);
+	connect(reply,SIGNAL(readyRead()),this,SLOT(readBody()));
+	connect(reply,SIGNAL(finished()),this,SLOT(replyFinished()));
+	connect(reply,SIGNAL(destroyed()),this,SLOT(replyDestroyed())); // eg the network manager was replaced
+	timer.start(timeout);
+}
+
+bool LeapFetcher::busy()
+{
+	return part.isOpen();
+}
+
+void LeapFetcher::setTimeout(int ms)
+{
+	timeout=ms;
+}
+
+QString LeapFetcher::validatorFile(const QString &file)
+{
+	return file + ".http";
+}
+
+//
+// Private slots
+//
+
+void LeapFetcher::readBody()
+{
+	if (!reply || !part.isOpen()) return;
+	QByteArray chunk = reply->readAll();
+	if (part.size() + chunk.size() > MaxSize){
+		qWarning() << "LeapFetcher: too big to be a leap second file";
+		reply->abort(); // finished() follows
+		return;
+	}
+	if (part.write(chunk) != chunk.size()){
+		qWarning() << "LeapFetcher: can't write " << part.fileName();
+		reply->abort();
+	}
+}
+
+void LeapFetcher::replyFinished()
+{
+	timer.stop();
+	QNetworkReply *r = reply;
+	if (!r || !part.isOpen()) return;
+	
+	int status = r->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(); // 0 for file:// URLs
+	if (r->error() != QNetworkReply::NoError){
+		qWarning() << "LeapFetcher: " << r->errorString();
+		finish(Failed);
+	}
+	else if (status == 304){
+		qDebug() << "LeapFetcher: not modified";
+		finish(NotModified);
+	}
+	else{
+		readBody();
+		part.close();
+		LeapFile lf;
+		if (!lf.read(part.fileName())){
+			qWarning() << "LeapFetcher: rejected the download: " << lf.error();
+			finish(Failed);
+		}
+		else if (rename(QFile::encodeName(part.fileName()).constData(),QFile::encodeName(target).constData()) != 0){
+			qWarning() << "LeapFetcher: can't replace " << target << ": " << strerror(errno);
+			finish(Failed);
+		}
+		else{
+			saveValidators(r); // after the rename, so that they never describe a file we don't have
+			finish(Updated);
+		}
+	}
+	r->deleteLater();
+}
+
+void LeapFetcher::replyDestroyed()
+{
+	if (busy()) // before it finished
+		finish(Failed);
+}
+
+void LeapFetcher::timedOut()
+{
+	qWarning() << "LeapFetcher: timed out";
+	if (reply)
+		reply->abort(); // finished() follows
+	else if (busy())
+		finish(Failed);
+}
+
+//
+//
+//
+
+void LeapFetcher::finish(int result)
+{
+	timer.stop();
+	if (part.isOpen())
+		part.close();
+	if (result != Updated)
+		part.remove();
+	reply=NULL;
+	emit fetched(result);
+}
+
+void LeapFetcher::saveValidators(QNetworkReply *r)
+{
+	QByteArray etag = r->rawHeader("ETag");
+	QByteArray lastModified = r->rawHeader("Last-Modified");
+	QString fname = validatorFile(target);
+	if (etag.isEmpty() && lastModified.isEmpty()){
+		QFile::remove(fname);
+		return;
+	}
+	QFile vf(fname);
+	if (!vf.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)){
+		qWarning() << "LeapFetcher: can't write " << fname;
+		return;
+	}
+	if (!etag.isEmpty())
+		vf.write("ETag: " + etag + "\n");
+	if (!lastModified.isEmpty())
+		vf.write("Last-Modified: " + lastModified + "\n");
+}
@@ -0,0 +1,84 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __LEAP_FETCHER_H_
+#define __LEAP_FETCHER_H_
+
+#include <QFile>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+
+class QNetworkAccessManager;
+
+// Downloads the leap second file.
+// The request is conditional on the ETag and Last-Modified of the cached copy, which are kept next to it
+// in <file>.http, so an unchanged file isn't downloaded again. The body is streamed to <file>.part, checked
+// with LeapFile and only then renamed over the cached copy, so readers always see a whole, good file.
+// Runs on the GUI thread, with the GUI's network manager.
+
+class LeapFetcher : public QObject
+{
+	Q_OBJECT
+	
+	public:
+	
+		enum Result {Failed,NotModified,Updated};
+		enum {Timeout=60000,MaxSize=1048576}; // ms, bytes; the file is about 10 kB
+		
+		LeapFetcher(QObject *parent=NULL);
+		
+		void fetch(QNetworkAccessManager *,const QString &,const QString &); // URL, cached file
+		bool busy();
+		void setTimeout(int); // ms
+		
+		static QString validatorFile(const QString &);
+		
+	signals:
+	
+		void fetched(int); // a Result
+		
+	private slots:
+	
+		void readBody();
+		void replyFinished();
+		void replyDestroyed();
+		void timedOut();
+		
+	private:
+	
+		void finish(int);
+		void saveValidators(QNetworkReply *);
+		
+		QPointer<QNetworkReply> reply;
+		QFile part;
+		QString target;
+		QTimer timer;
+		int timeout;
+};
+
+#endif
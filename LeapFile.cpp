@@ -0,0 +1,181 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <string.h>
+
+#include <QCryptographicHash>
+#include <QFile>
+
+#include "LeapFile.h"
+
+// The field starting at p: digits for base 10, hex digits for base 16. Returns the end of it, or p if none
+static const char *number(const char *p,const char *end,int base,quint64 &val)
+{
+	val=0;
+	const char *q=p;
+	while (q < end && q-p < 16){
+		int d;
+		char c=*q;
+		if (c >= '0' && c <= '9') d = c-'0';
+		else if (base == 16 && c >= 'a' && c <= 'f') d = c-'a'+10;
+		else if (base == 16 && c >= 'A' && c <= 'F') d = c-'A'+10;
+		else break;
+		val = val*base + d;
+		q++;
+	}
+	return q;
+}
+
+static const char *skipSpace(const char *p,const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+	return p;
+}
+
+LeapFile::LeapFile()
+{
+	lastUpdate=expiry=0;
+	valid=false;
+}
+
+bool LeapFile::read(const QString &fname)
+{
+	QFile f(fname);
+	if (!f.open(QIODevice::ReadOnly))
+		return fail("can't open " + fname,0);
+	if (f.size() > 0){
+		uchar *m = f.map(0,f.size());
+		if (m){
+			bool ok = parse((const char *) m,f.size());
+			f.unmap(m);
+			return ok;
+		}
+	}
+	QByteArray ba = f.readAll(); // not mappable, eg a pipe
+	return parse(ba.constData(),ba.size());
+}
+
+bool LeapFile::parse(const char *p,qint64 n)
+{
+	leapTable.clear();
+	lastUpdate=expiry=0;
+	valid=false;
+	
+	QCryptographicHash sha1(QCryptographicHash::Sha1);
+	QByteArray hash;
+	const char *end = p+n;
+	int lineNum=0;
+	
+	while (p < end){
+		lineNum++;
+		const char *eol = (const char *) memchr(p,'\n',end-p);
+		if (!eol) eol=end;
+		quint64 v1,v2;
+		
+		if (*p == '#'){
+			char c = (p+1 < eol ? p[1] : 0);
+			if (c == '$' || c == '@'){
+				const char *f = skipSpace(p+2,eol);
+				const char *fend = number(f,eol,10,v1);
+				if (fend == f || v1 > 0xffffffffULL) return fail(QString("bad #%1 line").arg(QLatin1Char(c)),lineNum);
+				sha1.addData(f,fend-f);
+				if (c == '$') lastUpdate=v1; else expiry=v1;
+			}
+			else if (c == 'h'){
+				// five groups of hex digits; leading zeros have been known to go missing, so they're restored
+				const char *f = skipSpace(p+2,eol);
+				while (f < eol){
+					const char *fend = number(f,eol,16,v1);
+					if (fend == f || fend-f > 8) return fail("bad #h line",lineNum);
+					hash += QByteArray(8-(fend-f),'0') + QByteArray(f,fend-f).toLower();
+					f = skipSpace(fend,eol);
+				}
+			}
+			// anything else is a comment
+		}
+		else{
+			const char *f1 = skipSpace(p,eol);
+			if (f1 < eol){ // not a blank line, so it has to be an entry: NTP time, TAI-UTC, optional comment
+				const char *f1end = number(f1,eol,10,v1);
+				const char *f2 = skipSpace(f1end,eol);
+				const char *f2end = number(f2,eol,10,v2);
+				const char *rest = skipSpace(f2end,eol);
+				if (f1end == f1 || f2 == f1end || f2end == f2 || (rest < eol && *rest != '#') || v1 > 0xffffffffULL)
+					return fail("bad entry",lineNum);
+				sha1.addData(f1,f1end-f1);
+				sha1.addData(f2,f2end-f2);
+				leapTable.append(LeapInfo(v1,v2));
+			}
+		}
+		p = eol+1;
+	}
+	
+	if (leapTable.size() == 0) return fail("no entries",lineNum);
+	if (!expiry) return fail("no expiry (#@)",lineNum);
+	if (hash.isEmpty()) return fail("no hash (#h), so it may be truncated",lineNum);
+	if (hash != sha1.result().toHex()) return fail("hash doesn't match",lineNum);
+	
+	leapTable.sort();
+	valid=true;
+	err="";
+	return true;
+}
+
+bool LeapFile::isValid()
+{
+	return valid;
+}
+
+QString LeapFile::error()
+{
+	return err;
+}
+
+LeapTable &LeapFile::table()
+{
+	return leapTable;
+}
+
+unsigned int LeapFile::updated()
+{
+	return lastUpdate;
+}
+
+unsigned int LeapFile::expires()
+{
+	return expiry;
+}
+
+//
+//
+//
+
+bool LeapFile::fail(const QString &msg,int lineNum)
+{
+	valid=false;
+	leapTable.clear();
+	err = (lineNum > 0 ? QString("line %1: %2").arg(lineNum).arg(msg) : msg);
+	return false;
+}
@@ -0,0 +1,66 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __LEAP_FILE_H_
+#define __LEAP_FILE_H_
+
+#include <QByteArray>
+#include <QString>
+
+#include "LeapTable.h"
+
+// Reads a leap-seconds.list file (as distributed by IERS, NIST and tzdata) in a single pass over the raw
+// bytes, and checks it against its #h SHA-1 hash. The hash covers the #$ (last update) and #@ (expiry)
+// values and the first two fields of each entry, concatenated with whitespace and comments removed.
+// A file without a hash, or with a line that can't be parsed, is rejected, so that a truncated or
+// corrupt download never replaces a good table.
+
+class LeapFile
+{
+	public:
+	
+		LeapFile();
+		
+		bool read(const QString &); // memory-mapped if possible
+		bool parse(const char *,qint64);
+		
+		bool isValid();
+		QString error();
+		
+		LeapTable &table();
+		unsigned int updated(); // NTP time
+		unsigned int expires(); // NTP time
+		
+	private:
+	
+		bool fail(const QString &,int);
+		
+		LeapTable leapTable;
+		unsigned int lastUpdate,expiry;
+		bool valid;
+		QString err;
+};
+
+#endif
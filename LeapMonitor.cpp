@@ -0,0 +1,165 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <sys/timex.h>
+
+#include <QDateTime>
+#include <QDebug>
+
+#include "ClockSource.h"
+#include "LeapMonitor.h"
+
+#define MSPERDAY 86400000LL
+
+LeapPlan::LeapPlan()
+{
+	direction=0;
+	midnight=0;
+	taiUTC=0;
+	localHour=localMinute=0;
+}
+
+LeapMonitor::LeapMonitor(ClockSource *c)
+{
+	clock=c;
+	state=TIME_OK;
+	currPhase=None;
+	tableTAIUTC=0;
+	tai=-1;
+	lastPoll=nextPoll=0;
+	nPolls=0;
+}
+
+void LeapMonitor::update(qint64 t,int dt)
+{
+	tableTAIUTC=dt;
+	// A clock step in either direction forces a poll
+	if (nPolls == 0 || t < lastPoll || t >= nextPoll)
+		poll(t);
+}
+
+int LeapMonitor::phase()
+{
+	return currPhase;
+}
+
+bool LeapMonitor::leaping()
+{
+	return currPhase == Leaping;
+}
+
+int LeapMonitor::taiUTC(int dt)
+{
+	if (tai >= 10) // it has been at least 10 s since 1972, so anything less hasn't been set properly
+		return tai;
+	switch (currPhase){
+		case Leaping: // UTC is repeating a second that TAI isn't
+			return currPlan.taiUTC + 1;
+		case Done: // until the leap table catches up
+			if (dt == currPlan.taiUTC)
+				return dt + currPlan.direction;
+			break;
+	}
+	return dt;
+}
+
+bool LeapMonitor::kernelTAI()
+{
+	return tai >= 10;
+}
+
+LeapPlan &LeapMonitor::plan()
+{
+	return currPlan;
+}
+
+int LeapMonitor::polls()
+{
+	return nPolls;
+}
+
+//
+//
+//
+
+void LeapMonitor::poll(qint64 t)
+{
+	int prev = state;
+	state = clock->leapState();
+	int prevTAI = tai;
+	tai = clock->taiOffset();
+	nPolls++;
+	lastPoll=t;
+	
+	switch (state){
+		case TIME_INS:
+		case TIME_DEL:
+		{
+			int dir = (state == TIME_INS ? 1 : -1);
+			if (currPhase != Announced || currPlan.direction != dir){
+				makePlan(t,dir);
+				qDebug() << "LeapMonitor: leap second" << (dir > 0 ? "insertion" : "deletion") << "announced for" <<
+					QDateTime::fromMSecsSinceEpoch(currPlan.midnight).toUTC().toString(Qt::ISODate);
+			}
+			currPhase=Announced;
+			break;
+		}
+		case TIME_OOP:
+			if (currPhase != Announced && currPhase != Leaping) // missed the announcement
+				makePlan(t,1);
+			currPhase=Leaping;
+			break;
+		case TIME_WAIT:
+			if (currPhase == Announced || currPhase == Leaping) // only a leap we've seen has a plan
+				currPhase=Done;
+			break;
+		default:
+			currPhase=None;
+			break;
+	}
+	if (state != prev)
+		qDebug() << "LeapMonitor: kernel state" << prev << "->" << state;
+	if (tai != prevTAI)
+		qDebug() << "LeapMonitor: kernel TAI-UTC" << prevTAI << "->" << tai;
+	
+	// Poll every tick around an announced leap, otherwise once a minute
+	nextPoll = t + PollInterval;
+	if (currPhase != None){
+		qint64 start = currPlan.midnight - Window;
+		qint64 stop = currPlan.midnight + Window;
+		if (t >= start - PollInterval && t < stop) // nearly there, or in it
+			nextPoll = (t < start ? start : t + 1);
+	}
+}
+
+void LeapMonitor::makePlan(qint64 t,int dir)
+{
+	currPlan.direction=dir;
+	currPlan.midnight=(t/MSPERDAY + 1)*MSPERDAY;
+	currPlan.taiUTC=tableTAIUTC;
+	QTime local = QDateTime::fromMSecsSinceEpoch(currPlan.midnight - 1000).time(); // 23:59:59 UTC, in local time
+	currPlan.localHour=local.hour();
+	currPlan.localMinute=local.minute();
+}
@@ -0,0 +1,88 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __LEAP_MONITOR_H_
+#define __LEAP_MONITOR_H_
+
+#include <QtGlobal>
+
+class ClockSource;
+
+// What to show for each time scale around a leap second, worked out when the kernel announces it.
+// Unix time simply repeats 23:59:59, as POSIX has it, so it needs nothing here.
+
+class LeapPlan
+{
+	public:
+	
+		LeapPlan();
+		
+		int direction;        // +1 for an inserted second, -1 for a deleted one, 0 for none
+		qint64 midnight;      // the UTC midnight the leap second precedes, in ms since the Unix epoch
+		int taiUTC;           // TAI-UTC before the leap, from the leap table
+		int localHour,localMinute; // of the inserted second, which is shown as hh:mm:60
+};
+
+// Tracks the kernel's leap second state (TIME_INS/TIME_DEL once STA_INS/STA_DEL is set, TIME_OOP during
+// the inserted second, TIME_WAIT after) and TAI offset without calling adjtimex() on every tick. They are
+// polled once a minute, and on every tick only in the last few seconds before an announced leap and the
+// first few after.
+// TAI-UTC comes from the kernel when ntpd or chrony has set it, and otherwise from the leap table.
+
+class LeapMonitor
+{
+	public:
+	
+		enum Phase {None,Announced,Leaping,Done};
+		enum {PollInterval=60000,Window=2000}; // in ms
+		
+		LeapMonitor(ClockSource *);
+		
+		void update(qint64,int); // the UTC instant being displayed, in ms since the Unix epoch, and TAI-UTC from the leap table
+		
+		int phase();
+		bool leaping();        // in the inserted second, so 23:59:59 UTC should be shown as 23:59:60
+		int taiUTC(int);       // TAI-UTC, given what the leap table says, which may lag the kernel
+		bool kernelTAI();      // taiUTC() comes from the kernel
+		LeapPlan &plan();
+		
+		int polls(); // in total
+		
+	private:
+	
+		void poll(qint64);
+		void makePlan(qint64,int);
+		
+		ClockSource *clock;
+		int state;      // as adjtimex() returns it
+		int currPhase;
+		LeapPlan currPlan;
+		int tableTAIUTC; // for the plan
+		int tai;         // from the kernel, or -1
+		qint64 lastPoll,nextPoll;
+		int nPolls;
+};
+
+#endif
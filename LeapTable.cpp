@@ -0,0 +1,102 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+
+#include "LeapTable.h"
+
+static bool earlier(const LeapInfo &a,const LeapInfo &b)
+{
+	return a.tleap < b.tleap;
+}
+
+LeapTable::LeapTable()
+{
+	clear();
+}
+
+void LeapTable::clear()
+{
+	table.clear();
+	validFrom=validUntil=0;
+	cached=-1;
+}
+
+void LeapTable::append(const LeapInfo &li)
+{
+	table.append(li);
+	validFrom=validUntil=0;
+}
+
+void LeapTable::sort()
+{
+	std::stable_sort(table.begin(),table.end(),earlier); // the file should be in order anyway
+	validFrom=validUntil=0;
+}
+
+int LeapTable::size()
+{
+	return table.size();
+}
+
+const LeapInfo &LeapTable::at(int i)
+{
+	return table.at(i);
+}
+
+int LeapTable::dtTAIUTC(unsigned int t)
+{
+	int i = find(t);
+	return (i < 0 ? -1 : (int) table.at(i).dttaiutc);
+}
+
+int LeapTable::current(unsigned int t)
+{
+	if (t >= validFrom && t < validUntil)
+		return cached;
+	
+	int i = find(t);
+	validFrom = (i < 0 ? 0 : table.at(i).tleap - UNIXEPOCH);
+	validUntil = (i+1 < table.size() ? table.at(i+1).tleap - UNIXEPOCH : 0xffffffff);
+	cached = (i < 0 ? -1 : (int) table.at(i).dttaiutc);
+	return cached;
+}
+
+unsigned int LeapTable::nextLeap()
+{
+	return validUntil;
+}
+
+//
+//
+//
+
+int LeapTable::find(unsigned int t)
+{
+	// the last entry at or before t
+	LeapInfo key(t + UNIXEPOCH,0);
+	QVector<LeapInfo>::const_iterator it = std::upper_bound(table.constBegin(),table.constEnd(),key,earlier);
+	return (it - table.constBegin()) - 1;
+}
@@ -0,0 +1,79 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __LEAP_TABLE_H_
+#define __LEAP_TABLE_H_
+
+#include <QVector>
+
+#define UNIXEPOCH 0x83aa7e80  //  Unix epoch in the NTP time scale 
+
+class LeapInfo
+{
+public:
+    LeapInfo()
+    {
+        tleap=dttaiutc=0;
+    }
+    LeapInfo(unsigned int tl, unsigned int dt)
+    {
+        tleap=tl;
+        dttaiutc=dt;
+    }
+    unsigned int tleap; // NTP time
+    unsigned int dttaiutc; // delta TAI UTC
+};
+
+// The leap second table, sorted by time in one contiguous array.
+// current() caches the entry in effect and the instant of the next leap, so that on each tick it's
+// one comparison; the table is only searched when the time leaves that interval, or the table changes.
+
+class LeapTable
+{
+	public:
+	
+		LeapTable();
+		
+		void clear();
+		void append(const LeapInfo &); // in any order, followed by sort()
+		void sort();
+		
+		int size();
+		const LeapInfo &at(int);
+		
+		int dtTAIUTC(unsigned int);   // at a Unix time, or -1 if it's before the table starts
+		int current(unsigned int);    // the same, using the cache
+		unsigned int nextLeap();      // Unix time of the next leap after the last current(), or 0xffffffff if none
+		
+	private:
+	
+		int find(unsigned int);
+		
+		QVector<LeapInfo> table;
+		unsigned int validFrom,validUntil; // the cached value holds for validFrom <= t < validUntil
+		int cached;
+};
+
+#endif
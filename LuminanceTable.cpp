@@ -0,0 +1,98 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <QImage>
+
+#include "LuminanceTable.h"
+
+LuminanceTable::LuminanceTable()
+{
+	clear();
+}
+
+void LuminanceTable::build(const QImage &image)
+{
+	shift=0;
+	while ((qint64) (image.width() >> shift)*(image.height() >> shift) > MaxPixels)
+		shift++;
+	QImage im = image;
+	if (shift > 0)
+		im = image.scaled(image.width() >> shift,image.height() >> shift);
+	if (im.format() != QImage::Format_RGB32 && im.format() != QImage::Format_ARGB32)
+		im = im.convertToFormat(QImage::Format_ARGB32); // not premultiplied, so colours are as QImage::pixel() gives them
+	
+	int width=im.width(),height=im.height(); // locals, so that the stores below can't alias them
+	if (width == 0 || height == 0){
+		clear();
+		return;
+	}
+	int stride=width+1;
+	sums.fill(0,stride*(height+1));
+	w=width;
+	h=height;
+	
+	QVector<quint32> row(width);
+	quint32 *lum = row.data();
+	quint32 *s = sums.data();
+	for (int y=0;y<height;y++){
+		// A scanline at a time. The first and last loops have no dependencies between pixels, so
+		// the compiler can vectorise them; only the running sum along the row is serial.
+		const QRgb *px = (const QRgb *) im.constScanLine(y);
+		for (int x=0;x<width;x++) // luminance (r * 0.3) + (g * 0.59) + (b * 0.11), in 0 to 255
+			lum[x] = (77*qRed(px[x]) + 150*qGreen(px[x]) + 29*qBlue(px[x])) >> 8;
+		for (int x=1;x<width;x++)
+			lum[x] += lum[x-1];
+		const quint32 *above = s + y*stride + 1;
+		quint32 *here = s + (y+1)*stride + 1;
+		for (int x=0;x<width;x++)
+			here[x] = above[x] + lum[x];
+	}
+}
+
+void LuminanceTable::clear()
+{
+	sums.clear();
+	w=h=0;
+	shift=0;
+}
+
+bool LuminanceTable::isNull()
+{
+	return w == 0;
+}
+
+double LuminanceTable::mean(const QRect &r)
+{
+	if (isNull() || r.isEmpty()) return -1;
+	QRect sr(r.left() >> shift,r.top() >> shift,qMax(r.width() >> shift,1),qMax(r.height() >> shift,1));
+	QRect ir = QRect(0,0,w,h).intersected(sr);
+	if (ir.isEmpty()) return -1;
+	
+	int stride=w+1;
+	int x0=ir.left(),x1=ir.right()+1,y0=ir.top(),y1=ir.bottom()+1;
+	const quint32 *s = sums.constData();
+	quint32 sum = s[y1*stride + x1] - s[y0*stride + x1] - s[y1*stride + x0] + s[y0*stride + x0]; // wraps back to the exact sum
+	return sum/(255.0*ir.width()*ir.height());
+}
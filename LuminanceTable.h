@@ -0,0 +1,64 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __LUMINANCE_TABLE_H_
+#define __LUMINANCE_TABLE_H_
+
+#include <QMetaType>
+#include <QRect>
+#include <QVector>
+
+class QImage;
+
+// A summed-area table of a background image's luminance, so that the mean over any rectangle is
+// four lookups. It's built once per background, on the housekeeping thread, and costs 4 bytes a pixel.
+// Copies share the table.
+
+class LuminanceTable
+{
+	public:
+	
+		LuminanceTable();
+		
+		void build(const QImage &);
+		void clear();
+		bool isNull();
+		
+		double mean(const QRect &); // 0 to 1, or -1 if the rectangle is off the image
+		
+	private:
+	
+		// Sums are kept modulo 2^32, which is exact for any rectangle of up to this many pixels.
+		// Bigger images are halved until they fit.
+		enum {MaxPixels=16843009}; // 2^32/255
+		
+		QVector<quint32> sums; // (w+1) x (h+1), with a row and column of zeros first
+		int w,h;
+		int shift;             // the image was scaled down by 2^shift
+};
+
+Q_DECLARE_METATYPE(LuminanceTable)
+
+#endif
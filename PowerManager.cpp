@@ -33,11 +33,12 @@
 #include <QFileInfo>
 #include <QProcess>
 
+#include "ClockSource.h"
 #include "PowerManager.h"
 
 
-PowerManager::PowerManager(QTime &on,QTime &off):
-	on(on),off(off)
+PowerManager::PowerManager(ClockSource *clock,QTime &on,QTime &off):
+	clock(clock),on(on),off(off)
 {
 	policy= NightTime | Weekends;
 	enabled=true;
@@ -83,9 +84,16 @@ PowerManager::~PowerManager()
 
 void PowerManager::update()
 {
-	if (!enabled) return;
+	int action=NoAction;
 	
-	QDateTime now = QDateTime::currentDateTime();
+	mutex.lock();
+	
+	if (!enabled){
+		mutex.unlock();
+		return;
+	}
+	
+	QDateTime now = clock->currentDateTime();
 	
 	// Turn off on weekends
 	// Turn off between configured times
@@ -98,20 +106,14 @@ void PowerManager::update()
 			powerOn=false;
 	}
 	
-	// If no change then return
-	if (powerOn && (powerState == PowerSaveInactive))
-		return;
-	if (!powerOn && (powerState == PowerSaveActive))
-		return;
-	
 	if (powerOn && (powerState == PowerSaveActive))
 	{
-		displayOn();
+		action=TurnOn;
 		powerState=PowerSaveInactive;
 	}
 	else if (!powerOn && (powerState == PowerSaveInactive))
 	{
-		displayOff();
+		action=TurnOff;
 		powerState=PowerSaveActive;
 	}
 	else if (powerState == (PowerSaveOverridden | PowerSaveActive))
@@ -122,46 +124,59 @@ void PowerManager::update()
 			powerState=PowerSaveActive; // next bit of code takes care of powering back on
 			if (powerOn)
 			{
-				displayOn();
+				action=TurnOn;
 				powerState=PowerSaveInactive;
 			}
 			else
 			{
-				displayOff();
+				action=TurnOff;
 			}
 		}
 	}
+	
+	mutex.unlock();
+	
+	if (action == TurnOn)
+		displayOn();
+	else if (action == TurnOff)
+		displayOff();
 }
 
 void PowerManager::enable(bool en)
 {
+	QMutexLocker locker(&mutex);
 	enabled=en;
 }
 
 bool PowerManager::isEnabled()
 {
+	QMutexLocker locker(&mutex);
 	return enabled;
 }
 
 void PowerManager::setOnTime(QTime &t)
 {
+	QMutexLocker locker(&mutex);
 	on=t;
 	qDebug() << "Power on " << on.toString();
 }
 
 void PowerManager::setOffTime(QTime &t)
 {
+	QMutexLocker locker(&mutex);
 	off=t;
 	qDebug() << "Power off " << off.toString();
 }
 		
 void PowerManager::setPolicy(int pol)
 {
+	QMutexLocker locker(&mutex);
 	policy=pol;
 }
 
 void PowerManager::setOverrideTime(int t)
 {
+	QMutexLocker locker(&mutex);
 	overrideTime=t;
 }
 
@@ -172,19 +187,25 @@ void PowerManager::setOverrideTime(int t)
 // Configured in setup file
 void PowerManager::setXWindowsVT(int vt)
 {
-    XWindowsVT=vt;
+	QMutexLocker locker(&mutex);
+	XWindowsVT=vt;
 }
 
 void PowerManager::deviceEvent()
 {
 	// Device events turn the power back on tenporarily if the power is off
-	if (powerState==PowerSaveActive)
+	mutex.lock();
+	bool turnOn = (powerState==PowerSaveActive);
+	if (turnOn)
 	{
-		overrideStop = QDateTime::currentDateTime();
+		overrideStop = clock->currentDateTime();
 		overrideStop = overrideStop.addSecs(overrideTime*60);
 		powerState |= PowerSaveOverridden;
-		displayOn();
 	}
+	mutex.unlock();
+	
+	if (turnOn)
+		displayOn();
 }
 
 //
@@ -217,6 +238,10 @@ void PowerManager::displayOn()
 	
 	if (videoTool==Unknown) return;
 
+	mutex.lock();
+	int vt = XWindowsVT;
+	mutex.unlock();
+	
 	QProcess pwr;
 	switch (videoTool)
 	{
@@ -227,7 +252,7 @@ void PowerManager::displayOn()
 			pwr.start("sudo chvt 1"); // this is black magic to kick the xserver back to life - may need to allow this command without password in sudoers
 			pwr.waitForStarted();
 			pwr.waitForFinished();
-			pwr.start("sudo chvt " + QString::number(XWindowsVT));
+			pwr.start("sudo chvt " + QString::number(vt));
 			pwr.waitForStarted();
 			pwr.waitForFinished();
 			break;
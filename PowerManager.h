@@ -28,6 +28,12 @@
 
 
 #include <QDateTime>
+#include <QMutex>
+
+class ClockSource;
+
+// update() runs on the housekeeping thread, while the configuration is set from the GUI thread,
+// so the state is guarded by a mutex. The (slow) display commands run outside the lock.
 
 class PowerManager
 {
@@ -37,7 +43,7 @@ class PowerManager
 		enum VideoTool  {RaspberryPi,XSet,Unknown};
 		enum PowerState {PowerSaveActive=0x01,PowerSaveInactive=0x02,PowerSaveOverridden=0x04};
 		
-		PowerManager(QTime &,QTime &);
+		PowerManager(ClockSource *,QTime &,QTime &);
 		~PowerManager();
 
 		void update();
@@ -54,10 +60,13 @@ class PowerManager
 		
 	private:
 		
+		enum Action {NoAction,TurnOn,TurnOff};
+		
 		void disableOSPowerManagment();
 		void displayOn();
 		void displayOff();
 		
+		ClockSource *clock;
 		int policy;
 		QTime on,off;
 		QDateTime overrideStop;
@@ -69,6 +78,8 @@ class PowerManager
 		int videoTool;
 		QString videoToolCmd;
 		int XWindowsVT; // VT X windows runs on (RPi only)
+		
+		QMutex mutex;
 };
 
 #endif
@@ -0,0 +1,201 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstring>
+
+#include <QPainter>
+
+#include "TextLayer.h"
+
+// Copy rather than share, so that the caller's string is never left shared and can be
+// rewritten in place on the next tick without allocating.
+static void copyText(QString &dst,const QString &src)
+{
+	if (dst == src) return;
+	dst.resize(src.size());
+	memcpy(dst.data(),src.constData(),src.size()*sizeof(QChar));
+}
+
+TextLayer::TextLayer()
+{
+	alignment=Qt::AlignCenter;
+	col=Qt::white;
+	enabled=false;
+	useAtlas=false;
+}
+
+void TextLayer::setGeometry(const QRect &r)
+{
+	rect=r;
+}
+
+QRect TextLayer::geometry()
+{
+	return rect;
+}
+
+void TextLayer::setFont(const QFont &f)
+{
+	fnt=f;
+}
+
+QFont TextLayer::font()
+{
+	return fnt;
+}
+
+void TextLayer::setColour(const QColor &c)
+{
+	col=c;
+}
+
+QColor TextLayer::colour()
+{
+	return col;
+}
+
+void TextLayer::setAlignment(int a)
+{
+	alignment=a;
+}
+
+void TextLayer::setPrerendering(bool en)
+{
+	enabled=en;
+	back=Frame();
+}
+
+bool TextLayer::prerendering()
+{
+	return enabled;
+}
+
+void TextLayer::setGlyphAtlas(bool en)
+{
+	if (en == useAtlas) return;
+	useAtlas=en;
+	front.image=back.image=QImage(); // force a redraw
+}
+
+QString TextLayer::text()
+{
+	return currentText;
+}
+
+void TextLayer::prerender(const QString &txt)
+{
+	if (!enabled) return;
+	if (matches(front,txt) || matches(back,txt)) return; // nothing new to draw
+	render(back,txt);
+}
+
+QRegion TextLayer::showText(const QString &txt)
+{
+	copyText(currentText,txt);
+	
+	if (matches(front,txt)) return QRegion(); // unchanged, so no repaint
+	
+	QRegion dirty;
+	if (enabled && matches(back,txt)){
+		dirty = changed(front,txt);
+		Frame tmp=front;
+		front=back;
+		back=tmp;
+	}
+	else // missed, so draw it now
+		dirty = render(front,txt);
+	
+	return dirty.translated(rect.topLeft());
+}
+
+QRegion TextLayer::refresh()
+{
+	return showText(currentText);
+}
+
+void TextLayer::draw(QPainter &p)
+{
+	if (!front.image.isNull())
+		p.drawImage(rect.topLeft(),front.image);
+}
+
+//
+//
+//
+
+bool TextLayer::matches(Frame &f,const QString &txt)
+{
+	// the frame is stale if the text, colour, font or geometry has changed since it was drawn
+	return f.text == txt && sameStyle(f);
+}
+
+bool TextLayer::sameStyle(Frame &f)
+{
+	return !f.image.isNull() && f.colour == col && f.font == fnt && f.image.size() == rect.size();
+}
+
+QRegion TextLayer::changed(Frame &f,const QString &txt)
+{
+	// What has to be redrawn to turn the frame into one showing txt
+	QRect r(QPoint(0,0),rect.size());
+	if (useAtlas && sameStyle(f) && atlas.matches(fnt,col))
+		return atlas.changed(r,alignment,f.text,txt);
+	return QRegion(r);
+}
+
+QRegion TextLayer::render(Frame &f,const QString &txt)
+{
+	QSize sz = rect.size();
+	if (sz.isEmpty()){ // not laid out yet
+		f.image=QImage();
+		return QRegion();
+	}
+	
+	QRegion dirty = changed(f,txt);
+	
+	copyText(f.text,txt);
+	f.colour=col;
+	f.font=fnt;
+	if (f.image.size() != sz)
+		f.image = QImage(sz,QImage::Format_ARGB32_Premultiplied);
+	
+	QPainter p(&f.image);
+	p.setClipRegion(dirty);
+	p.setCompositionMode(QPainter::CompositionMode_Source);
+	p.fillRect(f.image.rect(),Qt::transparent);
+	p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+	
+	if (useAtlas && atlas.covers(txt)){
+		if (!atlas.matches(fnt,col)) // new size, colour or dimming
+			atlas.rebuild(fnt,col);
+		atlas.draw(p,f.image.rect(),alignment,txt);
+	}
+	else{
+		p.setFont(fnt);
+		p.setPen(col);
+		p.drawText(f.image.rect(),alignment,txt);
+	}
+	return dirty;
+}
@@ -0,0 +1,101 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __TEXT_LAYER_H_
+#define __TEXT_LAYER_H_
+
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QRect>
+#include <QRegion>
+#include <QString>
+
+#include "GlyphAtlas.h"
+
+class QPainter;
+
+// A line of text which changes every tick (the time of day or the date), drawn into its own
+// premultiplied ARGB frame for the ClockCanvas to blit.
+// When prerendering is enabled the next frame is drawn ahead of time into a back buffer, so that showing
+// text that matches it is just a swap.
+// Optionally, text is drawn by copying glyphs from a GlyphAtlas rather than by rasterising it. In that case
+// only the character cells which have changed are redrawn and repainted.
+
+class TextLayer
+{
+	public:
+	
+		TextLayer();
+		
+		void setGeometry(const QRect &);
+		QRect geometry();
+		void setFont(const QFont &);
+		QFont font();
+		void setColour(const QColor &);
+		QColor colour();
+		void setAlignment(int);
+		
+		void setPrerendering(bool);
+		bool prerendering();
+		void setGlyphAtlas(bool);
+		
+		QString text();
+		void prerender(const QString &);   // draw into the back buffer
+		QRegion showText(const QString &); // returns what needs repainting, in canvas coordinates
+		QRegion refresh();                 // redraw after a change of style
+		
+		void draw(QPainter &);
+		
+	private:
+	
+		class Frame
+		{
+			public:
+				QString text;
+				QColor colour;
+				QFont font;
+				QImage image;
+		};
+		
+		bool matches(Frame &,const QString &);
+		bool sameStyle(Frame &);
+		QRegion changed(Frame &,const QString &);
+		QRegion render(Frame &,const QString &);
+		
+		QRect rect;
+		QFont fnt;
+		QColor col;
+		int alignment;
+		QString currentText;
+		
+		bool enabled;
+		Frame front,back;
+		
+		bool useAtlas;
+		GlyphAtlas atlas;
+};
+
+#endif
@@ -0,0 +1,139 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "Theme.h"
+
+#define THRESHOLD  0.5  // luminance, between a dark and a light background
+#define HYSTERESIS 0.05 // either side of it, so that a background close to the threshold doesn't flip the colour
+
+Theme::Theme()
+{
+	for (int i=0;i<NColourSets;i++){
+		text[i]=Qt::white;
+		bk[i]=QColor(80,1,48);
+	}
+	text[LightBackground]=QColor("yellow");
+	dimLevel=25;
+	dim=false;
+	autoAdjust=false;
+	setLuminance(-1);
+	deriveDim();
+}
+
+void Theme::setTextColour(int set,const QColor &c)
+{
+	text[set]=c;
+	if (set == Normal) deriveDim();
+}
+
+QColor Theme::textColour(int set)
+{
+	return text[set];
+}
+
+void Theme::setBackgroundColour(int set,const QColor &c)
+{
+	bk[set]=c;
+	if (set == Normal) deriveDim();
+}
+
+QColor Theme::backgroundColour(int set)
+{
+	return bk[set];
+}
+
+void Theme::setDimLevel(int level)
+{
+	dimLevel=level;
+	deriveDim();
+}
+
+void Theme::setDimmed(bool d)
+{
+	dim=d;
+}
+
+bool Theme::dimmed()
+{
+	return dim;
+}
+
+void Theme::setAutoAdjust(bool a)
+{
+	autoAdjust=a;
+}
+
+void Theme::setLuminance(double l)
+{
+	for (int r=0;r<MaxRegions;r++)
+		setLuminance(r,l);
+}
+
+void Theme::setLuminance(int r,double l)
+{
+	if (r < 0 || r >= MaxRegions) return;
+	if (l < 0)
+		shade[r]=Normal;
+	else if (shade[r] == Normal) // nothing to stick to
+		shade[r]=(l <= THRESHOLD ? DarkBackground : LightBackground);
+	else if (l < THRESHOLD - HYSTERESIS)
+		shade[r]=DarkBackground;
+	else if (l > THRESHOLD + HYSTERESIS)
+		shade[r]=LightBackground;
+}
+
+int Theme::current()
+{
+	return (dim ? Dim : Normal);
+}
+
+int Theme::current(int r)
+{
+	if (dim) return Dim;
+	if (autoAdjust && r >= 0 && r < MaxRegions)
+		return shade[r];
+	return Normal;
+}
+
+QColor Theme::regionColour(int r)
+{
+	return text[current(r)];
+}
+
+QColor Theme::backgroundColour()
+{
+	return bk[current()];
+}
+
+//
+//
+//
+
+void Theme::deriveDim()
+{
+	if (dimLevel <= 0) return; // leave it alone rather than divide by zero
+	text[Dim]=text[Normal].darker((int) (100*100/dimLevel));
+	bk[Dim]=bk[Normal].darker((int) (100*100/dimLevel));
+}
@@ -0,0 +1,76 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __THEME_H_
+#define __THEME_H_
+
+#include <QColor>
+
+// The colours the clock face is painted with.
+// There are four sets: normal, dimmed, and the two that are picked automatically for light and dark
+// background images. Each set has a text colour and a plain background colour, used when there is no image.
+// Selecting a set is cheap, so the caller can just ask for the current colours and hand them to the canvas.
+// With automatic adjustment, each region of text (an element of the face, numbered by the caller) gets
+// the light or dark background set from the luminance behind it.
+
+class Theme
+{
+	public:
+	
+		enum ColourSet {Normal,Dim,LightBackground,DarkBackground,NColourSets};
+		enum {MaxRegions=8};
+		
+		Theme();
+		
+		void setTextColour(int,const QColor &);
+		QColor textColour(int);
+		void setBackgroundColour(int,const QColor &);
+		QColor backgroundColour(int);
+		void setDimLevel(int); // in percent; derives the dim set from the normal one
+		
+		void setDimmed(bool);
+		bool dimmed();
+		void setAutoAdjust(bool);
+		void setLuminance(double);     // of the background behind all the text, 0 to 1, or negative if unknown
+		void setLuminance(int,double); // behind one region
+		
+		int current();    // for the plain background
+		int current(int); // for a region's text
+		QColor regionColour(int);
+		QColor backgroundColour();
+		
+	private:
+	
+		QColor text[NColourSets];
+		QColor bk[NColourSets];
+		int dimLevel;
+		bool dim;
+		bool autoAdjust;
+		int shade[MaxRegions]; // the set picked for each region's background, with hysteresis
+		
+		void deriveDim();
+};
+
+#endif
@@ -0,0 +1,225 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include <QDebug>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "ClockSource.h"
+#include "TickScheduler.h"
+
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#define TFD_TIMER_CANCEL_ON_SET (1 << 1) // Linux 3.0, which older headers don't have
+#endif
+
+TickScheduler::TickScheduler(ClockSource *c,QObject *parent):QObject(parent)
+{
+	clock=c;
+	running=false;
+	offset=0;
+	halfTick=false;
+	halfTickDelay=500;
+	period=1000;
+	slot=0;
+	lastLateness=0;
+	notifier=NULL;
+	timer=NULL;
+	cancelOnSet=true;
+	connect(clock,SIGNAL(stepped()),this,SLOT(clockStepped()));
+	
+	// A simulated clock doesn't run at the kernel's rate, so its deadlines are converted to real
+	// intervals instead
+	fd = timerfd_create(clock->isSimulated() ? CLOCK_MONOTONIC : CLOCK_REALTIME,TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0){
+		// Not as precise, and a step of the clock isn't noticed until the next tick, but the display keeps going
+		qWarning() << "TickScheduler: timerfd_create() failed: " << strerror(errno) << " - using a QTimer";
+		timer = new QTimer(this);
+		timer->setSingleShot(true);
+#if QT_VERSION >= 0x050000
+		timer->setTimerType(Qt::PreciseTimer);
+#endif
+		connect(timer,SIGNAL(timeout()),this,SLOT(timerExpired()));
+		return;
+	}
+	notifier = new QSocketNotifier(fd,QSocketNotifier::Read,this);
+	connect(notifier,SIGNAL(activated(int)),this,SLOT(timerExpired()));
+}
+
+TickScheduler::~TickScheduler()
+{
+	if (fd >= 0) close(fd);
+}
+
+void TickScheduler::start()
+{
+	running=true;
+	arm();
+}
+
+void TickScheduler::stop()
+{
+	running=false;
+	if (timer) timer->stop();
+	if (fd < 0) return;
+	struct itimerspec its;
+	memset(&its,0,sizeof(its));
+	timerfd_settime(fd,0,&its,NULL);
+}
+
+void TickScheduler::setOffset(int ms)
+{
+	offset=ms;
+	if (running) arm();
+}
+
+void TickScheduler::setHalfTick(bool enable,int ms)
+{
+	halfTick=enable;
+	halfTickDelay=ms;
+	if (halfTickDelay <= 0 || halfTickDelay >= 1000)
+		halfTick=false;
+	if (running) arm();
+}
+
+void TickScheduler::setPeriod(int ms)
+{
+	period=ms;
+	if (period < 10 || period > 1000) // 100 Hz is plenty
+		period=1000;
+	if (running) arm();
+}
+
+int TickScheduler::tickPeriod()
+{
+	return period;
+}
+
+qint64 TickScheduler::lateness()
+{
+	return lastLateness;
+}
+
+qint64 TickScheduler::nextTick()
+{
+	return slot;
+}
+
+//
+//
+//
+
+void TickScheduler::timerExpired()
+{
+	uint64_t expirations;
+	if (fd >= 0 && read(fd,&expirations,sizeof(expirations)) < 0){
+		if (errno == ECANCELED) // the clock was stepped, so the armed deadline is meaningless
+			clockStepped();
+		return; // otherwise spurious
+	}
+	
+	qint64 t = clock->now();
+	if (t < (slot + offset - 500)*1000000LL){ // the clock has gone back without being set, into a simulated leap second
+		clockStepped();
+		return;
+	}
+	if (t < (slot + offset)*1000000LL){ // woken a little early (a QTimer, or rounding of a rate-scaled wait), so wait out the rest
+		arm();
+		return;
+	}
+	lastLateness = (t - (slot + offset)*1000000LL)/1000;
+	qint64 current = slot;
+	arm(); // before the tick is handled, so that a slow handler can't delay the next deadline
+	emit tick(current);
+}
+
+void TickScheduler::clockStepped()
+{
+	if (!running) return;
+	qDebug() << "TickScheduler: clock stepped";
+	arm();
+	lastLateness=0;
+	emit tick(clock->msecs() - offset);
+}
+
+void TickScheduler::arm()
+{
+	if (fd < 0 && !timer) return;
+	
+	// The next slot with a deadline in the future. If a tick was very late, missed slots are skipped
+	// rather than delivered in a burst
+	qint64 t = clock->now();
+	slot = nextSlot(t/1000000 - offset);
+	qint64 deadline = slot + offset;
+	
+	if (timer){ // re-armed from the clock on every tick, so it doesn't drift
+		qint64 wait = (qint64) ((deadline*1000000LL - t)/clock->rate()); // real ns
+		timer->start(qMax((qint64) 0,(wait + 999999)/1000000)); // not early
+		return;
+	}
+	
+	struct itimerspec its;
+	memset(&its,0,sizeof(its));
+	int flags = TFD_TIMER_ABSTIME | (cancelOnSet ? TFD_TIMER_CANCEL_ON_SET : 0);
+	if (clock->isSimulated()){
+		qint64 wait = (qint64) ((deadline*1000000LL - t)/clock->rate()); // real ns
+		if (wait <= 0) wait=1; // zero would disarm it
+		its.it_value.tv_sec  = wait/1000000000LL;
+		its.it_value.tv_nsec = wait%1000000000LL;
+		flags=0;
+	}
+	else{
+		its.it_value.tv_sec  = deadline/1000;
+		its.it_value.tv_nsec = (deadline % 1000)*1000000;
+	}
+	int ret = timerfd_settime(fd,flags,&its,NULL);
+	if (ret < 0 && errno == EINVAL && (flags & TFD_TIMER_CANCEL_ON_SET)){
+		// Older kernels don't have it; clock steps are then only caught by the check in timerExpired()
+		qWarning() << "TickScheduler: TFD_TIMER_CANCEL_ON_SET isn't supported";
+		cancelOnSet=false;
+		ret = timerfd_settime(fd,flags & ~TFD_TIMER_CANCEL_ON_SET,&its,NULL);
+	}
+	if (ret < 0)
+		qWarning() << "TickScheduler: timerfd_settime() failed: " << strerror(errno);
+}
+
+qint64 TickScheduler::nextSlot(qint64 t)
+{
+	// first slot strictly after t
+	qint64 sec = t - (t % 1000);
+	if (period < 1000){ // the frame grid restarts at each second, so the last frame may be short
+		qint64 next = sec + ((t - sec)/period + 1)*period;
+		return (next < sec + 1000 ? next : sec + 1000);
+	}
+	if (halfTick && t < sec + halfTickDelay)
+		return sec + halfTickDelay;
+	return sec + 1000;
+}
@@ -0,0 +1,92 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __TICK_SCHEDULER_H_
+#define __TICK_SCHEDULER_H_
+
+#include <QObject>
+
+class QSocketNotifier;
+class QTimer;
+
+class ClockSource;
+
+// Schedules display updates on absolute CLOCK_REALTIME deadlines, locked to the UTC second boundary.
+// With a simulated clock, deadlines are converted to real intervals at the clock's rate.
+// Each tick carries the instant it is meant to display, so a late tick does not push the next one later.
+// The offset (the <delay> setting) is added to every deadline: a negative offset updates the display
+// early, to compensate for the latency of the display itself.
+
+class TickScheduler : public QObject
+{
+	Q_OBJECT
+	
+	public:
+	
+		TickScheduler(ClockSource *,QObject *parent=NULL);
+		~TickScheduler();
+		
+		void start();
+		void stop();
+		
+		void setOffset(int);         // in ms
+		void setHalfTick(bool,int);  // an extra tick this many ms into each second, for blinking
+		void setPeriod(int);         // in ms; less than 1000 ticks this often within each second, ignoring the half tick
+		int  tickPeriod();
+		
+		qint64 lateness();  // of the most recent tick, in us
+		qint64 nextTick();  // the instant the next tick will display, in ms since the Unix epoch
+		
+	signals:
+	
+		void tick(qint64);  // the instant to display, in ms since the Unix epoch
+		
+	private slots:
+	
+		void timerExpired();
+		void clockStepped();
+		
+	private:
+	
+		void arm();
+		qint64 nextSlot(qint64);
+		
+		ClockSource *clock;
+		int fd;
+		QSocketNotifier *notifier;
+		QTimer *timer;    // instead, if there's no timerfd
+		bool cancelOnSet; // if the kernel supports TFD_TIMER_CANCEL_ON_SET
+		bool running;
+		
+		int offset;
+		bool halfTick;
+		int halfTickDelay;
+		int period;
+		
+		qint64 slot; // the instant the armed deadline will display, in ms
+		qint64 lastLateness;
+};
+
+#endif
@@ -0,0 +1,184 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <sys/socket.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <QDebug>
+#include <QSocketNotifier>
+
+#include "TickStats.h"
+
+//
+// LatencyHistogram
+//
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void LatencyHistogram::record(qint64 us)
+{
+	if (us < 0) us=0;
+	if (us > 0x7fffffff) us=0x7fffffff;
+	
+	int bin = us/BinWidth;
+	if (bin > NBins) bin=NBins;
+	bins[bin].fetchAndAddRelaxed(1);
+	total.fetchAndAddRelaxed(1);
+	
+	int v = (int) us;
+	int m = max.fetchAndAddRelaxed(0);
+	while (v > m){
+		if (max.testAndSetRelaxed(m,v)) break;
+		m = max.fetchAndAddRelaxed(0);
+	}
+}
+
+void LatencyHistogram::reset()
+{
+	for (int i=0;i<=NBins;i++)
+		bins[i].fetchAndStoreRelaxed(0);
+	total.fetchAndStoreRelaxed(0);
+	max.fetchAndStoreRelaxed(0);
+}
+
+int LatencyHistogram::count()
+{
+	return total.fetchAndAddRelaxed(0);
+}
+
+qint64 LatencyHistogram::percentile(double p)
+{
+	// Returns the upper edge of the bin containing the percentile, which is good enough at this resolution
+	int n = count();
+	if (n == 0) return 0;
+	int target = (int) (p*n/100.0);
+	if (target >= n) target = n-1;
+	int sum=0;
+	for (int i=0;i<NBins;i++){
+		sum += bins[i].fetchAndAddRelaxed(0);
+		if (sum > target){
+			qint64 edge = (qint64) (i+1)*BinWidth;
+			return (edge < maximum() ? edge : maximum());
+		}
+	}
+	return maximum(); // in the overflow bin
+}
+
+qint64 LatencyHistogram::maximum()
+{
+	return max.fetchAndAddRelaxed(0);
+}
+
+//
+// TickStats
+//
+
+int TickStats::signalFd[2]={-1,-1};
+
+TickStats::TickStats(QObject *parent):QObject(parent)
+{
+	notifier=NULL;
+	
+	// The usual self-pipe trick: the signal handler just writes a byte, and the dump happens in the event loop
+	if (socketpair(AF_UNIX,SOCK_STREAM,0,signalFd) < 0){
+		qWarning() << "TickStats: socketpair() failed: " << strerror(errno);
+		return;
+	}
+	notifier = new QSocketNotifier(signalFd[1],QSocketNotifier::Read,this);
+	connect(notifier,SIGNAL(activated(int)),this,SLOT(handleSignal()));
+	
+	struct sigaction sa;
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler = TickStats::signalHandler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(SIGUSR1,&sa,NULL) < 0)
+		qWarning() << "TickStats: sigaction() failed: " << strerror(errno);
+}
+
+TickStats::~TickStats()
+{
+	signal(SIGUSR1,SIG_DFL);
+	if (signalFd[0] >= 0) close(signalFd[0]);
+	if (signalFd[1] >= 0) close(signalFd[1]);
+	signalFd[0]=signalFd[1]=-1;
+}
+
+void TickStats::record(int m,qint64 us)
+{
+	if (m < 0 || m >= NMeasurements) return;
+	histograms[m].record(us);
+}
+
+void TickStats::dump()
+{
+	static const char *names[NMeasurements]={"tick lateness","showTime()","showDate()","paint"};
+	
+	fprintf(stderr,"rpiclock tick statistics (us)\n");
+	for (int i=0;i<NMeasurements;i++){
+		LatencyHistogram &h = histograms[i];
+		fprintf(stderr,"%-14s n=%d p50=%lld p99=%lld max=%lld\n",names[i],h.count(),
+			(long long) h.percentile(50),(long long) h.percentile(99),(long long) h.maximum());
+	}
+	fflush(stderr);
+}
+
+void TickStats::reset()
+{
+	for (int i=0;i<NMeasurements;i++)
+		histograms[i].reset();
+}
+
+qint64 TickStats::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (qint64) ts.tv_sec*1000000LL + ts.tv_nsec/1000;
+}
+
+//
+//
+//
+
+void TickStats::handleSignal()
+{
+	char c;
+	if (read(signalFd[1],&c,sizeof(c)) > 0)
+		dump();
+}
+
+void TickStats::signalHandler(int)
+{
+	char c=1;
+	if (write(signalFd[0],&c,sizeof(c)) < 0){} // nothing useful can be done here
+}
@@ -0,0 +1,90 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __TICK_STATS_H_
+#define __TICK_STATS_H_
+
+#include <QAtomicInt>
+#include <QObject>
+
+class QSocketNotifier;
+
+// Fixed-size histogram of latencies in us. Recording is lock-free.
+
+class LatencyHistogram
+{
+	public:
+	
+		enum {BinWidth=100,NBins=1000}; // 100 us bins, so 0 to 100 ms, plus an overflow bin
+		
+		LatencyHistogram();
+		
+		void record(qint64);
+		void reset();
+		
+		int count();
+		qint64 percentile(double);
+		qint64 maximum();
+		
+	private:
+	
+		QAtomicInt bins[NBins+1];
+		QAtomicInt total;
+		QAtomicInt max;
+};
+
+// Tick timing measurements, dumped with p50/p99/max to stderr on SIGUSR1
+
+class TickStats : public QObject
+{
+	Q_OBJECT
+	
+	public:
+	
+		enum Measurement {Lateness,ShowTime,ShowDate,Paint,NMeasurements};
+		
+		TickStats(QObject *parent=NULL);
+		~TickStats();
+		
+		void record(int,qint64);
+		void dump();
+		void reset();
+		
+		static qint64 now(); // monotonic, in us
+		
+	private slots:
+	
+		void handleSignal();
+		
+	private:
+	
+		static void signalHandler(int);
+		static int signalFd[2];
+		
+		QSocketNotifier *notifier;
+		LatencyHistogram histograms[NMeasurements];
+};
+
+#endif
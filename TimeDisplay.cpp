@@ -32,45 +32,63 @@
 // (6) Run rpiclock with --nocheck
 
 #include <sys/timex.h>
+#include <time.h>
 #include <netinet/in.h> // For ntohl() (byte order conversion) 
 
 #include <iostream>
+#include <limits>
 
 #include <QAction>
 #include <QApplication>
 #include <QDebug>
 #include <QDesktopWidget>
 #include <QInputDialog>
-#include <QLabel>
 #include <QMenu>
 #include <QtGui>
 #include <QtNetwork>
 #include <QTime>
 #include <QRegExp>
+#include <QSignalMapper>
+#include <QThread>
 #include <QUdpSocket>
 #include <QVBoxLayout>
 
+#include "ClockCanvas.h"
+#include "ClockSource.h"
+#include "Housekeeper.h"
+#include "LeapFetcher.h"
+#include "LeapMonitor.h"
+#include "LuminanceTable.h"
 #include "PowerManager.h"
+#include "TickScheduler.h"
+#include "TickStats.h"
 #include "TimeDisplay.h"
+#include "TimeScales.h"
+#include "ZoneInfo.h"
 
 #define VERSION_INFO "v0.1.3"
 
 #define LEAPSECONDS 18     // whatever's current
-#define GPSEPOCH 315964800 // GPS epoch in the Unix time scale
-#define UNIXEPOCH 0x83aa7e80  //  Unix epoch in the NTP time scale 
-#define DELTATAIGPS 19     // 
-#define MAXLEAPCHECKINTERVAL 1048576 // two weeks should be good enough
 #define NTPTIMEOUT 64 // waiting time for a NTP response, before declaring no sync
+#define PRERENDERDELAY 50 // ms after a tick before the next frame is drawn, leaving time for this one to be painted
+#define MAXPANELROWS 8    // before the panel gets another column
+#define PANELREGION ClockCanvas::NElements // the panel is coloured after the canvas's elements
+
+static_assert(PANELREGION < Theme::MaxRegions,"the theme needs a region for each element and the panel");
 
 extern QApplication *app;
 
 TimeDisplay::TimeDisplay(QStringList &args):QWidget()
 {
 
-	srandom(currentDateTime().toTime_t());
-	
 	fullScreen=true;
 	checkSync=true;
+	tickScheduler=NULL; // the timescale setters below need to know it doesn't exist yet
+	invalidateDate();
+	
+	QDateTime simStart,simLeap;
+	double simRate=1.0;
+	int simTAI=-1;
 	
 	for (int i=1;i<args.size();i++){ // skip the first
 		if (args.at(i) == "--nofullscreen")
@@ -83,6 +101,10 @@ TimeDisplay::TimeDisplay(QStringList &args):QWidget()
 			std::cout << "--license      print this help" << std::endl;
 			std::cout << "--nofullscreen run in a window" << std::endl;
 			std::cout << "--nocheck      disable checking of host synchronization" << std::endl;
+			std::cout << "--simulate <t> run a simulated clock from t (UTC, ISO format eg 2016-12-31T23:59:00)" << std::endl;
+			std::cout << "--rate <x>     run the simulated clock x times faster than real time" << std::endl;
+			std::cout << "--leap <t>     insert a leap second in the simulated clock just before t (a UTC midnight)" << std::endl;
+			std::cout << "--tai <s>      give the simulated clock a kernel TAI-UTC offset of s (before any leap second)" << std::endl;
 			std::cout << "--version      display version" << std::endl;
 			
 			exit(EXIT_SUCCESS);
@@ -124,6 +146,20 @@ TimeDisplay::TimeDisplay(QStringList &args):QWidget()
 		else if (args.at(i) == "--nocheck"){
 			checkSync=false;
 		}
+		else if (args.at(i) == "--simulate" && i+1 < args.size()){
+			simStart = QDateTime::fromString(args.at(++i),Qt::ISODate);
+			simStart.setTimeSpec(Qt::UTC);
+		}
+		else if (args.at(i) == "--rate" && i+1 < args.size()){
+			simRate = args.at(++i).toDouble();
+		}
+		else if (args.at(i) == "--leap" && i+1 < args.size()){
+			simLeap = QDateTime::fromString(args.at(++i),Qt::ISODate);
+			simLeap.setTimeSpec(Qt::UTC);
+		}
+		else if (args.at(i) == "--tai" && i+1 < args.size()){
+			simTAI = args.at(++i).toInt();
+		}
 		else{
 			std::cout << "rpiclock: Unknown option '"<< args.at(i).toStdString() << "'" << std::endl;
 			std::cout << "rpiclock: Use --help to get a list of available command line options"<< std::endl;
@@ -132,6 +168,20 @@ TimeDisplay::TimeDisplay(QStringList &args):QWidget()
 		}
 	}
 	
+	if (simStart.isValid()){
+		SimulatedClock *sim = new SimulatedClock(simStart.toMSecsSinceEpoch(),simRate,this);
+		if (simLeap.isValid())
+			sim->setLeapSecond(simLeap.toMSecsSinceEpoch());
+		sim->setTAIOffset(simTAI);
+		clock = sim;
+		checkSync=false; // the host's synchronisation has nothing to do with simulated time
+	}
+	else
+		clock = new SystemClock(this);
+	leapMonitor = new LeapMonitor(clock);
+	
+	srandom(currentDateTime().toTime_t());
+	
 	//QRect screen = app->desktop()->screenGeometry();
 	
 	setWindowTitle(tr("rpiclock"));
@@ -154,7 +204,7 @@ TimeDisplay::TimeDisplay(QStringList &args):QWidget()
 	QTime on(9,0,0);
 	QTime off(17,0,0);
 	
-	powerManager=new PowerManager(on,off);
+	powerManager=new PowerManager(clock,on,off);
 	powerManager->enable(false);
 	
 	// Look for a configuration file
@@ -204,250 +254,167 @@ TimeDisplay::TimeDisplay(QStringList &args):QWidget()
 		readConfig(configFile);
 	}
 	
-	// Layout is
-	// Top level layout contains the background widget
-	// The overlaying layout is parented to the background widget and consists of a vbox containing
-	// hb: title
-	// hb: TOD
-	// hb: calendar text
-	// hb: date
-	// The logo is parented to the date
+	// The whole face is painted by the canvas
+	// Top to bottom, it shows the title, time of day, calendar text, date (with the logo) and image credit
 	
 	QVBoxLayout *vb = new QVBoxLayout(this);
 	vb->setContentsMargins(0,0,0,0);
-	bkground = new QLabel("");
-	bkground->setObjectName("Background");
-	bkground->setAlignment(Qt::AlignCenter);
-	vb->addWidget(bkground);
-
-	vb = new QVBoxLayout(bkground);
-	vb->setContentsMargins(0,0,0,0);
-
-	QHBoxLayout * hb = new QHBoxLayout();
-	vb->addLayout(hb,1);
-	title = new QLabel("",bkground);
-	title->setFont(QFont("Monospace"));
-	title->setAlignment(Qt::AlignCenter);
-	hb->addWidget(title);
-
-	hb = new QHBoxLayout();
-	vb->addLayout(hb,1);
-	tod = new QLabel("--:--:--",bkground);
-	tod->setContentsMargins(0,160,0,160);
-	tod->setFont(QFont("Monospace"));
-	tod->setAlignment(Qt::AlignCenter);
-	hb->addWidget(tod);
-
-	hb = new QHBoxLayout();
-	hb->setContentsMargins(0,0,0,0);
-	vb->addLayout(hb,0);
-	calText = new QLabel("",bkground);
-	calText->setFont(QFont("Monospace"));
-	calText->setAlignment(Qt::AlignCenter);
-	hb->addWidget(calText,0);
-
-	hb = new QHBoxLayout();
-	vb->addLayout(hb,1);
-	date = new QLabel("56337",bkground);
-	date->setFont(QFont("Monospace"));
-	date->setAlignment(Qt::AlignCenter);
-	hb->addWidget(date);
-
-	hb = new QHBoxLayout();
-	hb->setContentsMargins(32,0,32,12);
-	vb->addLayout(hb,0);
-	imageInfo = new QLabel("Credit",bkground);
-	imageInfo->setFont(QFont("Monospace"));
-	imageInfo->setAlignment(Qt::AlignRight);
-	hb->addWidget( imageInfo);
-	if (!showImageInfo) imageInfo->hide();
-	
-	setWidgetStyleSheet();
-	
-	logoParentWidget= new QWidget(date);
-	hb=new QHBoxLayout(logoParentWidget);
-	hb->setContentsMargins(32,32,32,0);
-	logo = new QLabel();
+	canvas = new ClockCanvas(this);
+	canvas->setPrerendering(prerender);
+	canvas->setGlyphAtlas(glyphCache);
+	for (int e=0;e<ClockCanvas::NElements;e++)
+		canvas->setFont(e,QFont("Monospace"));
+	canvas->setText(ClockCanvas::TOD,"--:--:--");
+	canvas->setText(ClockCanvas::Date,"56337");
+	canvas->setText(ClockCanvas::ImageInfo,"Credit");
+	canvas->setTextVisible(ClockCanvas::ImageInfo,showImageInfo);
+	vb->addWidget(canvas);
+	
+	setTheme();
 	setLogoImages();
-	hb->addWidget(logo);
 	
 	createActions();
 	setContextMenuPolicy(Qt::CustomContextMenu);
 	connect(this,SIGNAL(customContextMenuRequested ( const QPoint & )),this,SLOT(createContextMenu(const QPoint &)));
 
-	switch (timeScale){
-		case Local:setLocalTime();break;
-		case GPS:setGPSTime();break;
-		case Unix:setUnixTime();break;
-		case UTC:setUTCTime();break;
-		case Countdown:setCountdownTime();break;
-	}
-	
-	timezone.prepend(":");
-	setenv("TZ",timezone.toStdString().c_str(),1);
-	tzset();
-	
-	updateBackgroundImage(true); // force the first one
+	configurePanel();
+	setTimeScale(timeScale);
+	setTimeZone();
+	
+	// The slow stuff is done on a separate thread, which posts results back to us
+	housekeeperThread = new QThread(this);
+	housekeeper = new Housekeeper(clock,powerManager);
+	housekeeper->moveToThread(housekeeperThread);
+	connect(housekeeperThread,SIGNAL(finished()),housekeeper,SLOT(deleteLater()));
+	connect(housekeeper,SIGNAL(backgroundChanged(QString,QImage,QImage,LuminanceTable,QString,QString)),
+		this,SLOT(setBackgroundImage(QString,QImage,QImage,LuminanceTable,QString,QString)));
+	connect(housekeeper,SIGNAL(lightLevelRead(bool)),this,SLOT(updateDimState(bool)));
+	connect(housekeeper,SIGNAL(configFileModified(QDateTime)),this,SLOT(checkConfigFile(QDateTime)));
+	connect(housekeeper,SIGNAL(leapSecondsChanged(int)),this,SLOT(setLeapSeconds(int)));
+	connect(housekeeper,SIGNAL(fetchLeapFile(QString,QString)),this,SLOT(fetchLeapFile(QString,QString)));
+	housekeeperThread->start();
+	
+	configureHousekeeper(true); // force the first background image
 	
 	netManager = new QNetworkAccessManager(this);
 	if (proxyServer != "" && proxyPort != -1)
 		netManager->setProxy(QNetworkProxy(QNetworkProxy::HttpProxy,proxyServer,proxyPort,proxyUser,proxyPassword)); // UNTESTED
 	
-	connect(netManager, SIGNAL(finished(QNetworkReply*)),
-         this, SLOT(replyFinished(QNetworkReply*)));
+	leapFetcher = new LeapFetcher(this);
+	connect(leapFetcher,SIGNAL(fetched(int)),housekeeper,SLOT(leapFileFetched(int)));
 	
 	ntpSocket = new QUdpSocket(this);
     ntpSocket->bind(0); // get a random port
 	connect(ntpSocket, SIGNAL(readyRead()), this, SLOT(readNTPDatagram()));
-	lastNTPReply = lastLeapFileFetch;
+	lastNTPReply = QDateTime(QDate(1970,1,1),QTime(0,0,0));
 	syncOK=false;
 						 
-	updateTimer = new QTimer(this);
-    #if QT_VERSION >= 0x050000
-    updateTimer->setTimerType(Qt::PreciseTimer);
-    #endif
-	connect(updateTimer,SIGNAL(timeout()),this,SLOT(updateTime()));
-	QDateTime now = currentDateTime();
-	updateTimer->start(wakeupTime-now.time().msec()); // don't try to get the first blink right
+	tickStats = new TickStats(this);
+	paintPending=false;
+	canvas->installEventFilter(this);
+	
+	tickScheduler = new TickScheduler(clock,this);
+	tickScheduler->setOffset(displayDelay);
+	tickScheduler->setHalfTick(blinkSeparator,blinkDelay);
+	tickScheduler->setPeriod(framePacer.period());
+	connect(tickScheduler,SIGNAL(tick(qint64)),this,SLOT(updateTime(qint64)));
+	tickScheduler->start();
+
+}
 
+TimeDisplay::~TimeDisplay()
+{
+	housekeeperThread->quit();
+	housekeeperThread->wait();
+	delete leapMonitor;
 }
 
 
 void 	TimeDisplay::keyPressEvent (QKeyEvent *ev)
 {
 	QWidget::keyPressEvent(ev);
-	powerManager->deviceEvent();
+	QMetaObject::invokeMethod(housekeeper,"deviceEvent",Qt::QueuedConnection);
 }
 
 void 	TimeDisplay::mouseMoveEvent (QMouseEvent *ev )
 {
 	QWidget::mouseMoveEvent(ev);
-	powerManager->deviceEvent();
+	QMetaObject::invokeMethod(housekeeper,"deviceEvent",Qt::QueuedConnection);
 }
 
 void 	TimeDisplay::mousePressEvent (QMouseEvent *ev )
 {
 	QWidget::mousePressEvent(ev);
-	powerManager->deviceEvent();
+	QMetaObject::invokeMethod(housekeeper,"deviceEvent",Qt::QueuedConnection);
 }
-	
-void TimeDisplay::updateTime()
-{
 
-	
-	if (adjustFontColour && autoAdjustFontColour){
-		QTime t;
-		t.start();
-		adjustFontColour=false;
-		
-		QImage im = bkground->pixmap()->toImage();
-	
-		QRect  imr = QRect(0,0,im.width(),im.height());
-		// Compute the origin of the centred image in the parent window co-ordinate system
-		// There doesn't seem to be a way to get Qt to tell you this
-		int dx = 0; 
-		int dy = 0;
-		if (im.width() != width()){
-			dx = (width() - im.width())/2;
-		}
-		
-		if (im.height() != height()){
-			dy = (height() - im.height())/2;
-		}
-		
-		QRect lr = tod->geometry();
-		// Now translate this rectangle so that it is in the coordinate system
-		// of the image
-		lr.translate(-dx,-dy);
-		
-		QRect ir = imr.intersected(lr);
-	
-		if (ir.isValid()){ // overlap
-			double lum=0;
-			for (int i=ir.left();i<=ir.right();i++) // bit slow - 20 ms on 2.4 GHz Xeon
-				for (int j=ir.top();j<=ir.bottom();j++){
-					QRgb px = im.pixel(i,j);
-					// luminance (r * 0.3) + (g * 0.59) + (b * 0.11). 
-					lum += qBlue(px)*0.11 + qRed(px)*0.3 + qGreen(px)*0.59;
-				}
-			lum = lum/((ir.right()-ir.left())*(ir.bottom()-ir.top()))/255.0;
-			qDebug() << lum  << " " << t.elapsed();
-			QColor oldColour = fontColour;
-			if (lum <= 0.5)
-				fontColour = darkBkFontColour;
-			else
-				fontColour = lightBkFontColour;
-
-			if (fontColour != oldColour){
-				QString txtColour;
-				txtColour.sprintf("color:rgba(%d,%d,%d,255)",
-					fontColour.red(),fontColour.green(),fontColour.blue());
-				title->setStyleSheet(txtColour);
-				tod->setStyleSheet(txtColour);
-				calText->setStyleSheet(txtColour);
-				date->setStyleSheet(txtColour);
-				imageInfo->setStyleSheet(txtColour);
-			}
-		}
+bool TimeDisplay::eventFilter(QObject *obj,QEvent *ev)
+{
+	if (obj == canvas && ev->type() == QEvent::Paint && paintPending){
+		paintPending=false;
+		qint64 latency = TickStats::now()-tickDeadline;
+		tickStats->record(TickStats::Paint,latency);
+		if (fractionDigits() > 0 && framePacer.record(latency))
+			fallBack();
 	}
-	updateLeapSeconds();
-	powerManager->update();
-	
-	QDateTime now = currentDateTime();
+	return QWidget::eventFilter(obj,ev);
+}
+
+void TimeDisplay::updateTime(qint64 tickTime)
+{
+	qint64 lateness = tickScheduler->lateness();
+	tickStats->record(TickStats::Lateness,lateness);
+	qint64 deadline = TickStats::now() - lateness;
+	
+	if (autoAdjustFontColour && !lumTable.isNull())
+		adjustTextColours();
+	// Display the instant the tick was scheduled for, not whenever we got here
+	// In UTC, so that there's no conversion to local time here; formatting does that from localZone
+	QDateTime now = utcDateTime(tickTime + timeOffset*60000LL);
+	leapMonitor->update(tickTime,leapSeconds+DELTATAIGPS); // cheap, unless a leap second is close
 	syncOK = syncOK && (lastNTPReply.secsTo(now)< NTPTIMEOUT); 
 	
+	bool dirty=false;
 	if (!checkSync || syncOK){
-		showTime(now);
-		showDate(now);
+		qint64 t0 = TickStats::now();
+		dirty = showTime(now);
+		qint64 t1 = TickStats::now();
+		dirty = showDate(now) || dirty;
+		tickStats->record(TickStats::ShowTime,t1-t0);
+		tickStats->record(TickStats::ShowDate,TickStats::now()-t1);
 	}
 	else{
-		tod->setText("--:--:--");
-		date->setText("Unsynchronised");
+		dirty = canvas->setText(ClockCanvas::TOD,"--:--:--");
+		dirty = canvas->setText(ClockCanvas::Date,"Unsynchronised") || dirty;
+		for (int i=0;i<panelText.size();i++)
+			dirty = canvas->setPanelText(i,"--:--:--") || dirty;
 	}
-	
-	if (checkPPS){
-		updatePPSState();
+	if (dirty){ // otherwise no paint follows, and the next one would be timed from this tick
+		tickDeadline=deadline;
+		paintPending=true;
 	}
 	
-	// Call repaint on tod and date ??
+	if (prerender && fractionDigits() == 0) // sub-second frames come too quickly to be worth it
+		QTimer::singleShot(PRERENDERDELAY,this,SLOT(prerenderNextFrame()));
 	
-	updateBackgroundImage(false); // slow, so delay this
+	// The rest only needs doing once a second, however fast the display is updated
+	uint sec = now.toTime_t();
+	if (sec == lastSecond) return;
+	lastSecond=sec;
 	
-	updateDimState(); // slow so delay this
-	
-	now = currentDateTime();
-	
-	if (blinkSeparator){
-		if (now.time().msec() < blinkDelay) 
-			updateTimer->start(blinkDelay-now.time().msec());
-		else
-			updateTimer->start(wakeupTime-blinkDelay);
+	if (checkPPS){
+		updatePPSState();
 	}
-	else
-		updateTimer->start(wakeupTime-now.time().msec());
 	
-	checkConfigFile();
+	// Leap seconds, power management, background, dimming and the config file
+	housekeeper->requestUpdate(now.toLocalTime()); // for the calendar's date
+	
 	if (checkSync) writeNTPDatagram();
 	
 }
 
-void TimeDisplay::updateDimState(){
+void TimeDisplay::updateDimState(bool lowLight){
 	if (!dimEnable) return;
-	bool lowLight=false;
-	
-	// Check the sensor reading
-	QFile lf(lightLevelFile);
-	if (lf.open(QFile::ReadOnly)){
-		QTextStream ts(&lf);
-		int currLightLevel=255;
-		ts >> currLightLevel;
-		if (ts.status() == QTextStream::Ok)
-			lowLight=currLightLevel < dimThreshold;
-		else
-			return;
-	}
-	else	
-		return;
 	
 	if (lowLight)
 		integratedLightLevel--;
@@ -461,32 +428,22 @@ void TimeDisplay::updateDimState(){
 	
 	if (!dimActive && integratedLightLevel==0){
 		dimActive=true;
-		
-		QString txtColour;
-		txtColour.sprintf("color:rgba(%d,%d,%d,255)",
-				dimFontColour.red(),dimFontColour.green(),dimFontColour.blue());
-		title->setStyleSheet(txtColour);
-		tod->setStyleSheet(txtColour);
-		calText->setStyleSheet(txtColour);
-		date->setStyleSheet(txtColour);
-		imageInfo->setStyleSheet(txtColour);
+		theme.setDimmed(true);
+		// Change everything before repainting, so that it all happens in the one frame
+		applyTheme();
+		if (!dimBkImage.isNull())
+			canvas->setBackground(dimBkImage);
+		canvas->setLogo(*dimLogo);
 		forceUpdate();
-		bkground->setPixmap(QPixmap::fromImage(*dimImage));
-		logo->setPixmap(QPixmap::fromImage(*dimLogo));
 	}
 	else if (dimActive && integratedLightLevel==5){
 		dimActive=false;
-		QString txtColour;
-		txtColour.sprintf("color:rgba(%d,%d,%d,255)",
-				fontColour.red(),fontColour.green(),fontColour.blue());
-		title->setStyleSheet(txtColour);
-		tod->setStyleSheet(txtColour);
-		calText->setStyleSheet(txtColour);
-		date->setStyleSheet(txtColour);
-		imageInfo->setStyleSheet(txtColour);
+		theme.setDimmed(false);
+		applyTheme();
+		if (!bkImage.isNull())
+			canvas->setBackground(bkImage);
+		canvas->setLogo(logo);
 		forceUpdate();
-		bkground->setPixmap(QPixmap(currentImage));
-		logo->setPixmap(logoImage);
 	}
 	else if (dimActive){
 	}
@@ -509,97 +466,129 @@ void TimeDisplay::toggleFullScreen()
 	setImageCreditFontSize();
 }
 
-void TimeDisplay::setLocalTime()
+void TimeDisplay::configurePanel()
 {
-	timeScale=Local;
-	TODFormat=hhmmss;
-	dateFormat=PrettyDate;
-	title->setText(localTimeBanner);
-	setTODFontSize(); 
-	setDateFontSize();
-	setTitleFontSize();
-	setCalTextFontSize();
-	setImageCreditFontSize();
-	updateActions();
-	setConfig("timescale","Local");
+	QStringList labels;
+	for (int i=0;i<panelScales.size();i++)
+		labels.append(panelScales.at(i) == Countdown ? BeforeCountdownBanner : banners.at(panelScales.at(i)));
+	labels += worldLabels;
+	panelText.resize(labels.size());
+	canvas->setPanel(labels,(labels.size() + MAXPANELROWS - 1)/MAXPANELROWS);
 }
 
-void TimeDisplay::setUTCTime()
+void TimeDisplay::setTimeScale(int scale)
 {
-	timeScale=UTC;
-	TODFormat=hhmmss;
-	dateFormat=MJD | DOY;
-	title->setText(UTCBanner);
+	if (scale < 0 || scale >= TimeScales::count()) return;
+	const ScaleDescriptor &sd = TimeScales::at(scale);
+	timeScale=scale;
+	if (sd.showsTimeOfDay())
+		TODFormat=secondsFormat;
+	dateFormat=sd.dateFormat;
+	canvas->setText(ClockCanvas::Title,scale == Countdown ? BeforeCountdownBanner : banners.at(scale));
+	applyTODFormat();
 	setTODFontSize(); 
 	setDateFontSize();
 	setTitleFontSize();
 	setCalTextFontSize();
 	setImageCreditFontSize();
 	updateActions();
-	setConfig("timescale","UTC");
+	timeScaleActions.at(scale)->setChecked(true); // when it comes from the config file
+	setConfig("timescale",sd.name);
 }
 
-void TimeDisplay::setUnixTime()
+void TimeDisplay::togglePowerManagement()
 {
-	timeScale=Unix;
-	dateFormat=MJD|DOY;
-	title->setText(UnixBanner);
-	setTODFontSize(); 
-	setDateFontSize();
-	setTitleFontSize();
-	setCalTextFontSize();
-	setImageCreditFontSize();
-	updateActions();
-	setConfig("timescale","UNIX");
+	powerManager->enable(!powerManager->isEnabled());
 }
 
-void TimeDisplay::setGPSTime()
+void TimeDisplay::toggleSeparatorBlinking()
 {
-	timeScale=GPS;
-	dateFormat=GPSDayWeek;
-	title->setText(GPSBanner);
-	setTODFontSize(); 
-	setDateFontSize();
-	setTitleFontSize();
-	setCalTextFontSize();
-	setImageCreditFontSize();
-	updateActions();
-	setConfig("timescale","GPS");
+	blinkSeparator=!blinkSeparator;
+	tickScheduler->setHalfTick(blinkSeparator,blinkDelay);
+	setConfig("blink",(blinkSeparator?"yes":"no"));
 }
 
-void TimeDisplay::setCountdownTime()
+void TimeDisplay::setHHMMTODFormat()
 {
-	timeScale=Countdown;
-	dateFormat=PrettyDate;
-	title->setText(BeforeCountdownBanner);
-	setTODFontSize(); 
-	setDateFontSize();
-	setTitleFontSize();
-	setCalTextFontSize();
-	setImageCreditFontSize();
-	updateActions();
-	setConfig("timescale","Countdown");
+	setTODFormat(hhmm);
 }
 
-void TimeDisplay::togglePowerManagement()
+void TimeDisplay::setHHMMSSTODFormat()
 {
-	powerManager->enable(!powerManager->isEnabled());
+	setTODFormat(hhmmss);
 }
 
-void TimeDisplay::toggleSeparatorBlinking()
+void TimeDisplay::setTenthsTODFormat()
 {
-	blinkSeparator=!blinkSeparator;
-	setConfig("blink",(blinkSeparator?"yes":"no"));
+	setTODFormat(hhmmss_t);
 }
 
-void TimeDisplay::setHHMMTODFormat()
+void TimeDisplay::setHundredthsTODFormat()
 {
-	TODFormat=hhmm;
+	setTODFormat(hhmmss_hh);
 }
 
-void TimeDisplay::setHHMMSSTODFormat()
+void TimeDisplay::setMillisecondsTODFormat()
+{
+	setTODFormat(hhmmss_ms);
+}
+
+void TimeDisplay::setTODFormat(int fmt)
+{
+	TODFormat=secondsFormat=fmt;
+	applyTODFormat();
+	setTODFontSize();
+}
+
+int TimeDisplay::fractionDigits()
+{
+	// the most shown by the time of day or the panel, which is what sets the frame rate
+	int digits = fractionDigits(timeScale);
+	for (int i=0;i<panelScales.size();i++)
+		digits = qMax(digits,fractionDigits(panelScales.at(i)));
+	if (!worldZones.isEmpty()) // shown like local time
+		digits = qMax(digits,fractionDigits(Local));
+	return digits;
+}
+
+int TimeDisplay::fractionDigits(int scale)
+{
+	// of a second, in a reading of the time scale
+	if (!TimeScales::at(scale).showsTimeOfDay() || TODFormat < hhmmss_t)
+		return 0;
+	return TODFormat - hhmmss;
+}
+
+int TimeDisplay::framePeriod(int digits,int minimum)
+{
+	// No point in updating faster than the last digit changes
+	int p=1000;
+	for (int i=0;i<digits;i++) p /= 10;
+	return (digits == 0 ? 1000 : qMax(p,minimum));
+}
+
+void TimeDisplay::applyTODFormat()
+{
+	setTickPeriod(framePeriod(fractionDigits(),1000/frameRate));
+}
+
+void TimeDisplay::setTickPeriod(int ms)
+{
+	framePacer.setPeriod(ms);
+	if (tickScheduler)
+		tickScheduler->setPeriod(ms);
+}
+
+void TimeDisplay::fallBack()
 {
-	TODFormat=hhmmss;
+	// Frames are missing their deadlines, so drop a digit and slow down
+	int digits = fractionDigits();
+	if (digits == 0) return;
+	TODFormat--;
+	int p = framePeriod(digits-1,2*framePacer.period());
+	qWarning() << "TimeDisplay: frames missed, falling back to" << (digits-1) << "fractional digits every" << p << "ms";
+	setTickPeriod(p);
+	setTODFontSize();
 }
 
 void TimeDisplay::set12HourFormat()
@@ -623,6 +612,42 @@ void TimeDisplay::setTimeOffset()
 		timeOffset=ret;
 }
 
+void TimeDisplay::stepSimulatedClock()
+{
+	SimulatedClock *sim = qobject_cast<SimulatedClock *>(clock);
+	if (!sim) return;
+	bool ok;
+	QString t = QInputDialog::getText(this,"Simulated clock","Step to (UTC, ISO format)",QLineEdit::Normal,
+		clock->currentDateTime().toUTC().toString(Qt::ISODate),&ok);
+	if (!ok) return;
+	QDateTime dt = QDateTime::fromString(t,Qt::ISODate);
+	dt.setTimeSpec(Qt::UTC);
+	if (dt.isValid())
+		sim->stepTo(dt.toMSecsSinceEpoch());
+}
+
+void TimeDisplay::setSimulationRate()
+{
+	SimulatedClock *sim = qobject_cast<SimulatedClock *>(clock);
+	if (!sim) return;
+	bool ok;
+	double r = QInputDialog::getDouble(this,"Simulated clock","Simulated seconds per second",sim->rate(),1,10000,1,&ok);
+	if (ok)
+		sim->setRate(r);
+}
+
+void TimeDisplay::prerenderNextFrame()
+{
+	// Called in the idle part of the current tick: draw what the next tick should show
+	if (checkSync && !syncOK) return;
+	QDateTime next = utcDateTime(tickScheduler->nextTick() + timeOffset*60000LL);
+	canvas->prerender(ClockCanvas::TOD,formatTime(next));
+	formatPanel(next);
+	for (int i=0;i<panelText.size();i++)
+		canvas->prerenderPanel(i,panelText.at(i));
+	canvas->prerender(ClockCanvas::Date,formatDate(next));
+}
+
 void TimeDisplay::setConfig(QString tag,QString val)
 {
 	QDomNodeList nl = doc.elementsByTagName(tag);
@@ -662,16 +687,20 @@ void TimeDisplay::createContextMenu(const QPoint &)
 
 	QMenu *cm = new QMenu(this);
 	
-	cm->addAction(localTimeAction);
-	cm->addAction(UTCTimeAction);
-	cm->addAction(UnixTimeAction);
-	cm->addAction(GPSTimeAction);
-	cm->addAction(CountdownTimeAction);
+	for (int i=0;i<timeScaleActions.size();i++) // with the countdown last
+		if (TimeScales::at(i).style != ScaleDescriptor::Interval)
+			cm->addAction(timeScaleActions.at(i));
+	for (int i=0;i<timeScaleActions.size();i++)
+		if (TimeScales::at(i).style == ScaleDescriptor::Interval)
+			cm->addAction(timeScaleActions.at(i));
 	
 	cm->addSeparator();
 	cm->addAction(sepBlinkingOnAction);
 	cm->addAction(HHMMSSFormatAction);
 	cm->addAction(HHMMFormatAction);
+	cm->addAction(tenthsFormatAction);
+	cm->addAction(hundredthsFormatAction);
+	cm->addAction(millisecondsFormatAction);
 	cm->addAction(twelveHourFormatAction);
 	cm->addAction(twentyFourHourFormatAction);
 	
@@ -682,6 +711,10 @@ void TimeDisplay::createContextMenu(const QPoint &)
 	cm->addSeparator();
 	cm->addAction(testLeap);
 	cm->addAction(offsetTime);
+	if (clock->isSimulated()){
+		cm->addAction(stepClockAction);
+		cm->addAction(clockRateAction);
+	}
 	
 	cm->addSeparator();
 	cm->addAction(saveSettingsAction);
@@ -692,25 +725,6 @@ void TimeDisplay::createContextMenu(const QPoint &)
 	delete cm;
 }
 
-void TimeDisplay::replyFinished(QNetworkReply *reply)
-{
-	qDebug() << "reply finished" << endl;
-	QByteArray ba = reply->readAll();
-	QString bas(ba);
-	qDebug() << "reply:" <<bas ;
-	if (!bas.isEmpty()){
-		qDebug() << "writing " << leapFile;
-		QFile f(leapFile);
-		if (f.open(QIODevice::WriteOnly | QIODevice::Text)){
-			QTextStream out(&f);
-			out << bas;
-			f.close();
-			readLeapFile();
-		}
-	}
-	reply->deleteLater();
-}
-
 void	TimeDisplay::readNTPDatagram()
 {
 	QByteArray data;
@@ -740,8 +754,15 @@ void TimeDisplay::setDefaults()
 	syncLossThreshold = 3600;
 	
 	timeScale=Local;
-	TODFormat=hhmmss;
+	TODFormat=secondsFormat=hhmmss;
+	frameRate=50;
+	lastSecond=0;
 	dateFormat=PrettyDate;
+	prerender=false;
+	glyphCache=true;
+	panelScales.clear();
+	worldZones.clear();
+	worldLabels.clear();
 	blinkSeparator=false;
 	blinkDelay=500;
 	leapSeconds = LEAPSECONDS;
@@ -749,21 +770,18 @@ void TimeDisplay::setDefaults()
 	timezone="Australia/Sydney";
 	
 	displayDelay=0;
- 	wakeupTime=1000+displayDelay;
 
 	defaultImage="";
 	backgroundMode = Fixed;
 	imagePath = "";
-	calItemText="";
 	logoImage="";
 	dimLogo=NULL;
 	slideshowPeriod=1;
 	showImageInfo=true;
 	
-	localTimeBanner="Local time";
-	UTCBanner="Coordinated Universal Time";
-	UnixBanner="Unix time";
-	GPSBanner="GPS time";
+	banners.clear();
+	for (int i=0;i<TimeScales::count();i++)
+		banners.append(TimeScales::at(i).banner);
 	BeforeCountdownBanner="Until ...";
 	AfterCountdownBanner="Since ...";
 	
@@ -777,10 +795,6 @@ void TimeDisplay::setDefaults()
 	proxyUser="";
 	proxyPassword="";
 	
-	leapsInitialized=false;
-	leapFileExpiry= QDateTime(QDate(1970,1,1),QTime(0,0,0));
-	lastLeapFileFetch=leapFileExpiry;
-	leapFileCheckInterval=8;
 	leapFile = "";
 	// Look for a system leap file
 	// On modern Linuxen, typically this is /usr/share/zoneinfo/leap-seconds.list
@@ -811,7 +825,6 @@ void TimeDisplay::setDefaults()
 	dimMethod=Software;
 	dimLevel=25;
 	dimActive=false;
-	dimImage=NULL;
 	lightLevelFile="";
 	dimThreshold=0;
 	integrationPeriod=5;
@@ -837,36 +850,19 @@ void TimeDisplay::createActions()
 	
 	QActionGroup *actionGroup = new QActionGroup(this);
 	
-	localTimeAction = actionGroup->addAction(QIcon(), tr("Local time"));
-	localTimeAction->setStatusTip(tr("Show local time"));
-	connect(localTimeAction, SIGNAL(triggered()), this, SLOT(setLocalTime()));
-	localTimeAction->setCheckable(true);
-	localTimeAction->setChecked(timeScale==Local);
-	
-	UTCTimeAction = actionGroup->addAction(QIcon(), tr("UTC time"));
-	UTCTimeAction->setStatusTip(tr("Show UTC time"));
-	connect(UTCTimeAction, SIGNAL(triggered()), this, SLOT(setUTCTime()));
-	UTCTimeAction->setCheckable(true);
-	UTCTimeAction->setChecked(timeScale==UTC);
-	
-	GPSTimeAction = actionGroup->addAction(QIcon(), tr("GPS time"));
-	GPSTimeAction->setStatusTip(tr("Show GPS time"));
-	connect(GPSTimeAction, SIGNAL(triggered()), this, SLOT(setGPSTime()));
-	GPSTimeAction->setCheckable(true);
-	GPSTimeAction->setChecked(timeScale==GPS);
-	
-	UnixTimeAction = actionGroup->addAction(QIcon(), tr("Unix time"));
-	UnixTimeAction->setStatusTip(tr("Show Unix time"));
-	connect(UnixTimeAction, SIGNAL(triggered()), this, SLOT(setUnixTime()));
-	UnixTimeAction->setCheckable(true);
-	UnixTimeAction->setChecked(timeScale==Unix);
-	
-	CountdownTimeAction = actionGroup->addAction(QIcon(), tr("Countdown time"));
-	CountdownTimeAction->setStatusTip(tr("Show Countdown time"));
-	connect(CountdownTimeAction, SIGNAL(triggered()), this, SLOT(setCountdownTime()));
-	CountdownTimeAction->setCheckable(true);
-	CountdownTimeAction->setChecked(timeScale==Countdown);
-	
+	QSignalMapper *timeScaleMapper = new QSignalMapper(this);
+	connect(timeScaleMapper,SIGNAL(mapped(int)),this,SLOT(setTimeScale(int)));
+	timeScaleActions.clear();
+	for (int i=0;i<TimeScales::count();i++){
+		const ScaleDescriptor &sd = TimeScales::at(i);
+		QAction *action = actionGroup->addAction(QIcon(), tr(sd.menuText));
+		action->setStatusTip(tr("Show %1").arg(tr(sd.menuText)));
+		connect(action, SIGNAL(triggered()), timeScaleMapper, SLOT(map()));
+		timeScaleMapper->setMapping(action,i);
+		action->setCheckable(true);
+		action->setChecked(timeScale==i);
+		timeScaleActions.append(action);
+	}
 	
 	hourFormatActionGroup = new QActionGroup(this);
 	
@@ -910,6 +906,24 @@ void TimeDisplay::createActions()
 	HHMMFormatAction->setCheckable(true);
 	HHMMFormatAction->setChecked(TODFormat==hhmmss);
 	
+	tenthsFormatAction=TODFormatActionGroup->addAction(QIcon(), tr("HHMMSS.s format"));
+	tenthsFormatAction->setStatusTip(tr("Set time of day format to HH:MM:SS.s"));
+	connect(tenthsFormatAction, SIGNAL(triggered()), this, SLOT(setTenthsTODFormat()));
+	tenthsFormatAction->setCheckable(true);
+	tenthsFormatAction->setChecked(TODFormat==hhmmss_t);
+	
+	hundredthsFormatAction=TODFormatActionGroup->addAction(QIcon(), tr("HHMMSS.ss format"));
+	hundredthsFormatAction->setStatusTip(tr("Set time of day format to HH:MM:SS.ss"));
+	connect(hundredthsFormatAction, SIGNAL(triggered()), this, SLOT(setHundredthsTODFormat()));
+	hundredthsFormatAction->setCheckable(true);
+	hundredthsFormatAction->setChecked(TODFormat==hhmmss_hh);
+	
+	millisecondsFormatAction=TODFormatActionGroup->addAction(QIcon(), tr("HHMMSS.sss format"));
+	millisecondsFormatAction->setStatusTip(tr("Set time of day format to HH:MM:SS.sss"));
+	connect(millisecondsFormatAction, SIGNAL(triggered()), this, SLOT(setMillisecondsTODFormat()));
+	millisecondsFormatAction->setCheckable(true);
+	millisecondsFormatAction->setChecked(TODFormat==hhmmss_ms);
+	
 	testLeap = new QAction(QIcon(), tr("Fetch leap table"), this);
 	testLeap->setStatusTip(tr("Fetch leap second table"));
 	addAction(testLeap);
@@ -920,6 +934,16 @@ void TimeDisplay::createActions()
 	addAction(offsetTime);
 	connect(offsetTime, SIGNAL(triggered()), this, SLOT(setTimeOffset()));
 	
+	stepClockAction = new QAction(QIcon(), tr("Step simulated clock"), this);
+	stepClockAction->setStatusTip(tr("Step the simulated clock to a chosen instant"));
+	addAction(stepClockAction);
+	connect(stepClockAction, SIGNAL(triggered()), this, SLOT(stepSimulatedClock()));
+	
+	clockRateAction = new QAction(QIcon(), tr("Set simulation rate"), this);
+	clockRateAction->setStatusTip(tr("Set how fast the simulated clock runs"));
+	addAction(clockRateAction);
+	connect(clockRateAction, SIGNAL(triggered()), this, SLOT(setSimulationRate()));
+	
 	saveSettingsAction = new QAction(QIcon(), tr("Save settings"), this);
 	saveSettingsAction->setStatusTip(tr("Save settings"));
 	addAction(saveSettingsAction);
@@ -935,160 +959,379 @@ void TimeDisplay::createActions()
 
 void TimeDisplay::updateActions()
 {
-	hourFormatActionGroup->setEnabled(timeScale==Local);
-	TODFormatActionGroup->setEnabled(timeScale==Local);
-	sepBlinkingOnAction->setEnabled(timeScale == UTC || timeScale == Local);
+	bool localTime = (TimeScales::at(timeScale).style == ScaleDescriptor::LocalTime) || !worldZones.isEmpty();
+	bool timeOfDay = TimeScales::at(timeScale).showsTimeOfDay() || !worldZones.isEmpty();
+	for (int i=0;i<panelScales.size();i++){ // the panel follows the same formats
+		localTime = localTime || (TimeScales::at(panelScales.at(i)).style == ScaleDescriptor::LocalTime);
+		timeOfDay = timeOfDay || TimeScales::at(panelScales.at(i)).showsTimeOfDay();
+	}
+	hourFormatActionGroup->setEnabled(localTime);
+	TODFormatActionGroup->setEnabled(timeOfDay);
+	sepBlinkingOnAction->setEnabled(timeOfDay);
+}
+
+bool TimeDisplay::showTime(QDateTime &now)
+{
+	bool dirty=false;
+	if (timeScale == Countdown){
+		QString &banner = (now < countdownDateTime ? BeforeCountdownBanner : AfterCountdownBanner);
+		dirty = canvas->setText(ClockCanvas::Title,banner); // only repaints when the banner changes
+	}
+	dirty = canvas->setText(ClockCanvas::TOD,formatTime(now)) || dirty;
+	formatPanel(now);
+	for (int i=0;i<panelText.size();i++)
+		dirty = canvas->setPanelText(i,panelText.at(i)) || dirty;
+	return dirty;
+}
+
+void TimeDisplay::formatPanel(QDateTime &now)
+{
+	// From the same clock reading as the time of day, so that everything agrees
+	for (int i=0;i<panelScales.size();i++)
+		formatTime(now,panelScales.at(i),panelText[i]);
+	qint64 t = now.toMSecsSinceEpoch();
+	for (int i=0;i<worldZones.size();i++)
+		formatZoneTime(t,worldZones[i],panelText[panelScales.size()+i]);
+}
+
+void TimeDisplay::formatZoneTime(qint64 t,ZoneInfo &zone,QString &text)
+{
+	// Just arithmetic, since the zone's offset is cached until its next transition
+	const ZoneOffset &z = zone.at(t);
+	int ms = msOfDay(t + z.utcOffset*1000LL);
+	int sec = ms/1000;
+	fmt.clear();
+	appendClock(sec/3600,(sec/60)%60,leapSecond(t) ? 60 : sec%60,ms%1000,fractionDigits(Local),
+		hourFormat != TwentyFourHour,(blinkSeparator && ms%1000 >= blinkDelay) ? ' ' : ':');
+	fmt.append(' ');
+	fmt.append(z.abbreviation);
+	fmt.copyTo(text);
+}
+
+void TimeDisplay::appendClock(int hr,int mn,int sec,int msec,int digits,bool twelveHour,char sep)
+{
+	if (TODFormat >= hhmmss && twelveHour)
+		fmt.appendNumber(TimeFormatter::twelveHour(hr));
+	else
+		fmt.appendTwoDigits(hr);
+	fmt.append(sep);
+	fmt.appendTwoDigits(mn);
+	if (TODFormat >= hhmmss){
+		fmt.append(sep);
+		fmt.appendTwoDigits(sec);
+	}
+	fmt.appendFraction(msec,digits);
+}
+
+qint64 TimeDisplay::toLocal(qint64 utc)
+{
+	// utc relabelled with the local time, in ms; from the C library if the zone file couldn't be read
+	if (localZone.isValid())
+		return localZone.toLocal(utc);
+	time_t t = utc/1000 - (utc % 1000 < 0 ? 1 : 0); // rounded down, even before 1970
+	struct tm tm;
+	localtime_r(&t,&tm);
+	return utc + tm.tm_gmtoff*1000LL;
+}
+
+QDateTime TimeDisplay::utcDateTime(qint64 ms)
+{
+	// without going through local time
+	QDateTime dt;
+	dt.setTimeSpec(Qt::UTC);
+	dt.setMSecsSinceEpoch(ms);
+	return dt;
+}
+
+int TimeDisplay::msOfDay(qint64 t)
+{
+	const qint64 msPerDay=86400000;
+	qint64 ms = t % msPerDay;
+	return (ms < 0 ? ms + msPerDay : ms);
 }
 
-void TimeDisplay::showTime(QDateTime &now)
+bool TimeDisplay::leapSecond(qint64 t)
 {
+	// In an inserted leap second the kernel repeats 23:59:59 UTC, which is shown as 23:59:60
+	return leapMonitor->leaping() && t >= 0 && (t/1000) % 86400 == 86399; // a small sanity check
+}
+
+const QString &TimeDisplay::formatTime(QDateTime &now)
+{
+	formatTime(now,timeScale,todText);
+	return todText;
+}
+
+const QString &TimeDisplay::formatTime(QDateTime &now,int scale,int todFormat,int hrFormat,bool blink)
+{
+	// The display's own settings are left as they were
+	int tf=TODFormat,hf=hourFormat;
+	bool b=blinkSeparator;
+	TODFormat=todFormat;
+	hourFormat=hrFormat;
+	blinkSeparator=blink;
+	formatTime(now,scale,todText);
+	TODFormat=tf;
+	hourFormat=hf;
+	blinkSeparator=b;
+	return todText;
+}
+
+void TimeDisplay::formatTime(QDateTime &now,int scale,QString &text)
+{
+	
+	qint64 utc = now.toMSecsSinceEpoch();
+	bool leaping = leapSecond(utc);
 	
 	char sep=':';
 	
 	if (blinkSeparator){
-		if (now.time().msec() >= blinkDelay) sep=' ';
+		if (msOfDay(utc) % 1000 >= blinkDelay) sep=' ';
 	}
 	
-	QDateTime UTCnow = now.toUTC();
+	const ScaleDescriptor &sd = TimeScales::at(scale);
+	const qint64 msPerDay=86400000;
 	
-	// leap secondy stuff
-	int leapCorrection=0;
-	struct timex tx;
-	tx.modes=0;
-	int ret = adjtimex(&tx);
-	qDebug() << UTCnow.time() <<  " " <<  UTCnow.time().msec() <<" " << ret << " " << tx.status ;
-	if (UTCnow.time().hour() == 23 && UTCnow.time().minute() == 59 && UTCnow.time().second() ==59) // a small sanity check
+	fmt.clear();
+	switch (sd.style)
 	{
-		tx.modes=0;		
-		ret = adjtimex(&tx);
-
-		if (ret == TIME_OOP)
-			leapCorrection = 1;
-	}
-		
-	QString s;
-	switch (timeScale)
-	{
-		case Local:
+		case ScaleDescriptor::LocalTime:
 		{
-			if (TODFormat == hhmmss){
-				if (hourFormat == TwentyFourHour)
-					s.sprintf("%02d%c%02d%c%02d",now.time().hour(),sep,now.time().minute(),sep,now.time().second()+leapCorrection);
-				else
-				{
-					int hr=now.time().hour();
-					if (now.time().hour() > 12)  hr=now.time().hour()-12;
-					if (now.time().hour() == 0 ) hr=now.time().hour()+12;
-					s.sprintf("%d%c%02d%c%02d",hr,sep,now.time().minute(),sep,now.time().second()+leapCorrection);
-				}
-			}
-			else{ 
-				s.sprintf("%02d%c%02d",now.time().hour(),sep,now.time().minute());
+			// From the zone's cached offset, which is right through the repeated or skipped hour
+			int ms = msOfDay(toLocal(utc));
+			int sec = ms/1000;
+			int hr=sec/3600,mn=(sec/60)%60;
+			sec %= 60;
+			if (leaping){
+				LeapPlan &plan = leapMonitor->plan();
+				hr=plan.localHour;
+				mn=plan.localMinute;
+				sec=60;
 			}
+			appendClock(hr,mn,sec,ms%1000,fractionDigits(scale),hourFormat != TwentyFourHour,sep);
 			break;
 		}
-		case UTC:
-			if (TODFormat == hhmmss){
-				s.sprintf("%02d%c%02d%c%02d",UTCnow.time().hour(),sep,UTCnow.time().minute(),sep,UTCnow.time().second()+leapCorrection);
-			}
-			else{
-				s.sprintf("%02d%c%02d",UTCnow.time().hour(),sep,UTCnow.time().minute());
-			}
+		case ScaleDescriptor::TimeOfDay: // atomic scales are continuous, so never show 60 s
+		{
+			int ms = msOfDay(sd.label(utc,taiUTC()));
+			int sec = ms/1000;
+			appendClock(sec/3600,(sec/60)%60,leaping && !sd.atomic ? 60 : sec%60,ms%1000,fractionDigits(scale),false,sep);
+			break;
+		}
+		case ScaleDescriptor::Seconds: // Unix time repeats 23:59:59 in a leap second, as POSIX has it
+			fmt.appendNumber(sd.reading(utc,taiUTC())/1000);
 			break;
-		case Unix:
-			s.sprintf("%i",(int) now.toTime_t());
+		case ScaleDescriptor::WeekSeconds: // continuous through a leap second
+			fmt.appendNumber((sd.reading(utc,taiUTC())/1000) % (86400*7));
 			break;
-		case GPS:
+		case ScaleDescriptor::Days:
 		{
-			int nsecs = now.toTime_t()-GPSEPOCH+leapSeconds+leapCorrection;
-			int nweeks = int(nsecs/86400/7);
-			s.sprintf("%i",nsecs - nweeks*86400*7);
+			qint64 ms = sd.reading(utc,taiUTC());
+			int frac = ((ms % msPerDay)*100000)/msPerDay; // five places is 0.864 s, so it moves every tick
+			fmt.appendNumber(ms/msPerDay);
+			fmt.append('.');
+			fmt.appendTwoDigits(frac/1000);
+			for (int div=100;div>0;div /= 10)
+				fmt.append('0' + (frac/div)%10);
 			break;
 		}
-		case Countdown:
+		case ScaleDescriptor::Interval:
 		{
 			int dt = now.toTime_t() - countdownDateTime.toTime_t();
-			if (dt <0){
-				title->setText(BeforeCountdownBanner);
+			if (dt <0)
 				dt *= -1;
-			}
-			else{
-				title->setText(AfterCountdownBanner);
-			}
-			s.sprintf("%i s", dt); 
+			fmt.appendNumber(dt);
+			fmt.append(" s");
 			break;
 		}
 	}
-	tod->setText(s);
+	fmt.copyTo(text);
 }
 
-void TimeDisplay::showDate(QDateTime & now)
+bool TimeDisplay::showDate(QDateTime &now)
 {
-		QString s(""),stmp;
-		QString sep="";
+	return canvas->setText(ClockCanvas::Date,formatDate(now));
+}
+
+const QString &TimeDisplay::formatDate(QDateTime & utcNow)
+{
+		// Scales with a calendar of their own show their date, and otherwise it's the local date.
+		// Only the instant we're given is used, whatever its time spec.
+		const ScaleDescriptor &sd = TimeScales::at(timeScale);
+		qint64 utc = utcNow.toMSecsSinceEpoch();
+		qint64 t = (sd.ownCalendar ? sd.label(utc,taiUTC()) : utc);
 		
-		QDateTime tmpdt;
-		if (timeScale != Countdown)
-			tmpdt=now;
-		else
-			tmpdt=countdownDateTime;
+		// The date line changes at most once a day, so it's only rebuilt when the next rollover passes
+		if (t >= dateFrom && t < dateUntil && dateScale == timeScale && dateFlags == dateFormat)
+			return dateText;
 		
+		const char *sep="";
+		
+		qint64 instant = (timeScale != Countdown ? utc : countdownDateTime.toMSecsSinceEpoch()); // in UTC
+		QDate d = (timeScale != Countdown ? utcDateTime(sd.ownCalendar ? t : toLocal(utc)).date() : countdownDateTime.date());
+		
+		fmt.clear();
 		if (dateFormat & ISOdate){
-			s.append(sep);
-			s.append(tmpdt.toString("yyyy-MM-dd"));		
+			fmt.append(sep);
+			fmt.appendFourDigits(d.year());
+			fmt.append('-');
+			fmt.appendTwoDigits(d.month());
+			fmt.append('-');
+			fmt.appendTwoDigits(d.day());
 			sep="  ";
 		}
 		if (dateFormat & PrettyDate){
-			s.append(sep);
-			s.append(tmpdt.toString("dd MMM yyyy"));
-            s.remove('.'); // kludge Qt5 is adding a period after month name. Locale?
+			fmt.append(sep);
+			fmt.appendTwoDigits(d.day());
+			fmt.append(' ');
+			fmt.appendMonthName(d.month());
+			fmt.append(' ');
+			fmt.appendFourDigits(d.year());
 			sep=" ";
 		}
 		if (dateFormat & MJD){
-			s.append(sep);
-			int tt = tmpdt.toTime_t();
-			stmp.sprintf("MJD %d",tt/86400 + 40587);
-			s.append(stmp);
+			fmt.append(sep);
+			int tt = (timeScale != Countdown ? t : instant)/1000;
+			fmt.append("MJD ");
+			fmt.appendNumber(tt/86400 + 40587);
 			sep=" ";
 		}
 		if (dateFormat & GPSDayWeek){
-			s.append(sep);
-			int nsecs = tmpdt.toTime_t()-GPSEPOCH+leapSeconds;
+			fmt.append(sep);
+			int nsecs = TimeScales::at(weekScale()).reading(instant,taiUTC())/1000;
 			int wn = int(nsecs/86400/7);
 			int dn  = int((nsecs- wn*86400*7)/86400);
-			stmp.sprintf("Wn %i Dn %i",wn,dn);
-			s.append(stmp);
+			fmt.append("Wn ");
+			fmt.appendNumber(wn);
+			fmt.append(" Dn ");
+			fmt.appendNumber(dn);
 			sep=" ";
 		}
 		if (dateFormat & DOY){
-			s.append(sep);
+			fmt.append(sep);
 			int doy=1;
-			if (timeScale == UTC || timeScale == Unix){
-				QDateTime UTCtmpdt = tmpdt.toUTC();
-				doy=UTCtmpdt.date().dayOfYear();
-			}
+			if (timeScale == UTC || timeScale == Unix)
+				doy=utcDateTime(instant).date().dayOfYear();
 			else
-				doy=tmpdt.date().dayOfYear();
-			stmp.sprintf("DOY %d",doy);
-			s.append(stmp);
+				doy=d.dayOfYear();
+			fmt.append("DOY ");
+			fmt.appendNumber(doy);
 			sep=" ";
 		}
-		date->setText(s);
+		if (dateFormat & FourYearDay){ // the four year period and the day in it
+			fmt.append(sep);
+			int days = Scale<GLONASS>::reading(instant,0)/86400000;
+			fmt.append("N4 ");
+			fmt.appendNumber(days/1461 + 1);
+			fmt.append(" NT ");
+			fmt.appendNumber(days%1461 + 1);
+			sep=" ";
+		}
+		fmt.copyTo(dateText);
+		
+		dateFrom=t;
+		dateUntil=dateRollover(t,instant);
+		dateScale=timeScale;
+		dateFlags=dateFormat;
+		return dateText;
+}
+
+const QString &TimeDisplay::formatDate(QDateTime &now,int scale,int flags)
+{
+	// The cache is keyed on the scale and flags, so the display's next date line is rebuilt
+	int ts=timeScale,df=dateFormat;
+	timeScale=scale;
+	dateFormat=flags;
+	formatDate(now);
+	timeScale=ts;
+	dateFormat=df;
+	return dateText;
+}
+
+void TimeDisplay::setCountdown(const QDateTime &dt)
+{
+	countdownDateTime=dt;
+	invalidateDate();
+}
+
+qint64 TimeDisplay::dateRollover(qint64 t,qint64 utc)
+{
+	// The first instant after t at which some part of the date line changes, in ms since the epoch
+	// of t's labelling, which is the scale's own if it has a calendar and otherwise UTC
+	const qint64 msPerDay=86400000;
+	if (timeScale == Countdown) // shows countdownDateTime, which only changes with the config
+		return std::numeric_limits<qint64>::max();
+	
+	qint64 next = std::numeric_limits<qint64>::max();
+	qint64 utcMidnight = (t/msPerDay + 1)*msPerDay; // MJD, and DOY for UTC and Unix time
+	qint64 midnight; // of the date shown
+	if (TimeScales::at(timeScale).ownCalendar)
+		midnight = utcMidnight;
+	else if (localZone.isValid())
+		midnight = localZone.nextRollover(t);
+	else
+		midnight = QDateTime(utcDateTime(toLocal(t)).date().addDays(1),QTime(0,0),Qt::LocalTime).toMSecsSinceEpoch();
+	
+	if (dateFormat & (ISOdate | PrettyDate))
+		next = qMin(next,midnight);
+	if (dateFormat & MJD)
+		next = qMin(next,utcMidnight);
+	if (dateFormat & GPSDayWeek){ // GPS days start GPS-UTC seconds before UTC midnight
+		qint64 r = TimeScales::at(weekScale()).reading(utc,taiUTC());
+		next = qMin(next,t + msPerDay - r % msPerDay);
+	}
+	if (dateFormat & DOY)
+		next = qMin(next,(timeScale == UTC || timeScale == Unix) ? utcMidnight : midnight);
+	if (dateFormat & FourYearDay) // GLONASS days start at 21:00 UTC
+		next = qMin(next,t + msPerDay - Scale<GLONASS>::reading(utc,0) % msPerDay);
+	return next;
+}
+
+int TimeDisplay::weekScale()
+{
+	// whose weeks and days the date line shows: the navigation system's, or GPS for anything else
+	return (TimeScales::at(timeScale).style == ScaleDescriptor::WeekSeconds ? timeScale : int(GPS));
+}
+
+int TimeDisplay::taiUTC()
+{
+	// from the kernel if it knows, otherwise from the leap table
+	return leapMonitor->taiUTC(leapSeconds+DELTATAIGPS);
+}
+
+void TimeDisplay::setTimeZone()
+{
+	// For power management, the calendar and anything else working in local time
+	QString tz = ":" + timezone;
+	setenv("TZ",tz.toStdString().c_str(),1);
+	tzset();
+	
+	// The display converts from UTC itself, so the zone file is only read again when the setting changes
+	if (localZone.isValid() && localZone.name() == timezone) return;
+	if (!localZone.load(timezone))
+		qWarning() << "local time from the C library, since" << timezone << "can't be used:" << localZone.error();
+	invalidateDate();
+}
+
+void TimeDisplay::invalidateDate()
+{
+	dateUntil=dateFrom=0;
 }
 
 void TimeDisplay::forceUpdate()
 {
-	QDateTime now = QDateTime::currentDateTime();
+	QDateTime now = currentDateTime();
 	if (!checkSync || syncOK){
 		showTime(now);
 		showDate(now);
 	}
 	else{
-		tod->setText("--:--:--");
-		date->setText("Unsynchronised");
+		canvas->setText(ClockCanvas::TOD,"--:--:--");
+		canvas->setText(ClockCanvas::Date,"Unsynchronised");
+		for (int i=0;i<panelText.size();i++)
+			canvas->setPanelText(i,"--:--:--");
 	}
-	tod->repaint();
-	date->repaint();
+	canvas->repaint();
 }
 
 void TimeDisplay::setTODFontSize()
@@ -1100,219 +1343,93 @@ void TimeDisplay::setTODFontSize()
 	if (fullScreen)
 		w = dtw->screenGeometry().width();
 	
-	QFont f = tod->font();
-	int tw=0;
+	QFont f = canvas->font(ClockCanvas::TOD);
 	QFontMetrics fm(f);
-	switch (timeScale)
-	{
-		case Local: case UTC:
-			if (TODFormat == hhmmss)
-				tw = fm.width("99:99:99");
-			else 
-				tw= fm.width("99:99");
-			break;
-		case Unix:
-			tw = fm.width("1360930340");
-			break;
-		case GPS:
-			tw = fm.width("99:99:99"); // looks too big if you use TOW
-			break;
-		case Countdown:
-			tw=fm.width("999999999 s");
-			break;
-	}
+	int tw = fm.width(widestReading(timeScale));
 	f.setPointSize((0.9*f.pointSize()*w)/tw);
-	tod->setFont(f);
+	canvas->setFont(ClockCanvas::TOD,f);
+	
+	// The panel's cells share one size, fitted to the widest of them, so nothing is measured per tick.
+	// Readings get half of a column's width, and are kept well below the time of day. The whole
+	// panel gets no more than a third of the height.
+	int cells = panelText.size();
+	if (cells == 0) return;
+	int columns = (cells + MAXPANELROWS - 1)/MAXPANELROWS;
+	int rows = (cells + columns - 1)/columns;
+	QFontMetrics pfm(f);
+	int pw=1;
+	for (int i=0;i<panelScales.size();i++)
+		pw = qMax(pw,pfm.width(widestReading(panelScales.at(i))));
+	if (!worldZones.isEmpty())
+		pw = qMax(pw,pfm.width(widestReading(Local) + " WWWW")); // with the zone's abbreviation
+	int h=minimumHeight();
+	if (fullScreen)
+		h = dtw->screenGeometry().height();
+	int size = qMin((int) ((0.45*f.pointSize()*w)/(columns*pw)),f.pointSize()/4);
+	size = qMin(size,(int) ((f.pointSize()*h)/(3.0*rows*pfm.height())));
+	f.setPointSize(qMax(size,1));
+	canvas->setPanelFont(f);
+}
 
+QString TimeDisplay::widestReading(int scale)
+{
+	const ScaleDescriptor &sd = TimeScales::at(scale);
+	if (!sd.showsTimeOfDay())
+		return sd.widest;
+	if (TODFormat < hhmmss)
+		return "99:99";
+	int digits = fractionDigits(scale);
+	return QString("99:99:99") + (digits > 0 ? "." + QString(digits,'9') : QString());
 }
 
 void TimeDisplay::setDateFontSize()
 {
-	QFont ftod = tod->font();
-	QFont f = date->font();
+	QFont ftod = canvas->font(ClockCanvas::TOD);
+	QFont f = canvas->font(ClockCanvas::Date);
 	f.setPointSize(ftod.pointSize()/4);
-	date->setFont(f);
+	canvas->setFont(ClockCanvas::Date,f);
 }
 
 void TimeDisplay::setTitleFontSize()
 {
-	QFont ftod = date->font();
-	QFont f = title->font();
+	QFont ftod = canvas->font(ClockCanvas::Date);
+	QFont f = canvas->font(ClockCanvas::Title);
 	f.setPointSize(ftod.pointSize());
-	title->setFont(f);
+	canvas->setFont(ClockCanvas::Title,f);
 }
 
 void TimeDisplay::setCalTextFontSize()
 {
-	QFont ftod = tod->font();
-	QFont f = calText->font();
+	QFont ftod = canvas->font(ClockCanvas::TOD);
+	QFont f = canvas->font(ClockCanvas::CalText);
 	f.setPointSize(ftod.pointSize()/4);
-	calText->setFont(f);
+	canvas->setFont(ClockCanvas::CalText,f);
 }
 
 void TimeDisplay::setImageCreditFontSize()
 {
-	QFont ftod = tod->font();
-	QFont f = imageInfo->font();
+	QFont ftod = canvas->font(ClockCanvas::TOD);
+	QFont f = canvas->font(ClockCanvas::ImageInfo);
 	f.setPointSize(ftod.pointSize()/12);
-	imageInfo->setFont(f);
+	canvas->setFont(ClockCanvas::ImageInfo,f);
 }
 
 void TimeDisplay::updateLeapSeconds()
 {
-	
-	// If just starting then we need to read the leap file
-	//    If we don't have it then we need to fetch it
-	//    If we have it then read it
-	
-	// If the file has already been read, then we need to check
-	// expiry and fetch a new file
-	//
-	
-	QDateTime now = currentDateTime();
-	
-	if (autoUpdateLeapFile){
-		if (!leapsInitialized){
-			QFileInfo fi(leapFile);
-			if (fi.exists()){// Have we got a cached leap second list ?
-				readLeapFile();
-				if (leapFileExpiry.secsTo(now) > 0){ // time to look for a new one
-					qDebug() << "the leap file has expired";
-					fetchLeapSeconds();
-				}
-			}
-			else{
-				qDebug() << "no cached leap second file";
-				fetchLeapSeconds(); // not cached so try to get one
-			}
-		}
-		else{ // we have a file, so check it out ...
-			if (leapFileExpiry.secsTo(now) > 0){
-				fetchLeapSeconds();
-			}
-			else{ // have an up to date file so extract the current leap value
-				QDateTime now = currentDateTime();
-				unsigned int ttnow = now.toTime_t();
-	
-				for (int i=leapTable.size()-1;i>=0;i--){
-					if (ttnow >= leapTable.at(i)->tleap - UNIXEPOCH){
-						leapSeconds = leapTable.at(i)->dttaiutc - DELTATAIGPS;
-						qDebug() << leapTable.at(i)->tleap << 
-							" delta_TAI= " << leapTable.at(i)->dttaiutc << " ls =" << leapSeconds;
-						break;
-					}
-				}
-			}
-		}
-	}
-	else{ // using a system-supplied leap second file
-		if (!leapsInitialized){
-			// Have we got a leap second list 
-			QFileInfo fi(leapFile);
-			if (fi.exists()){
-				if (fi.lastModified() == leapFileLastModified){
-					qDebug() << "leap file still out of date";
-					return;
-				}
-				readLeapFile();
-				if (leapFileExpiry.secsTo(now) > 0) // out of date
-					leapsInitialized=false;
-			}
-		}
-	}
-	
-
+	QMetaObject::invokeMethod(housekeeper,"updateLeapSeconds",Qt::QueuedConnection,Q_ARG(QDateTime,currentDateTime()));
 }
 
-void TimeDisplay::fetchLeapSeconds()
+void TimeDisplay::setLeapSeconds(int ls)
 {
-	QDateTime now = currentDateTime();
-	qDebug() << lastLeapFileFetch.secsTo(now);
-	if (lastLeapFileFetch.secsTo(now) > leapFileCheckInterval){
-		qDebug() << "fetching leap second file " << leapFileURL ;
-		netManager->get(QNetworkRequest(QUrl(leapFileURL)));
-		lastLeapFileFetch = currentDateTime();
-		leapFileCheckInterval *= 2;
-		if (leapFileCheckInterval >  MAXLEAPCHECKINTERVAL)
-			leapFileCheckInterval = MAXLEAPCHECKINTERVAL;
-	}
+	leapSeconds=ls;
+	invalidateDate(); // for the GPS week and day
 }
 
-void TimeDisplay::readLeapFile()
+void TimeDisplay::fetchLeapFile(QString url,QString file)
 {
-
-	qDebug() << "reading leap seconds file " << leapFile;
-	
-	QFile file(leapFile);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
-		return;
-
-	while (!leapTable.isEmpty())
-		delete leapTable.takeFirst();
-	
-	QTextStream in(&file);
-	unsigned int lastLeap=0,deltaTAI=0;
-	
-	QRegExp leapInfo("^(\\d{10})\\s+(\\d+)");
-	
-	while (!in.atEnd()) {
-		QString line = in.readLine();
-	  if (line.startsWith("#@")) // expiry time in NTP time
-		{
-			QRegExp re("^#@\\s+(\\d{10})");
-			if (re.indexIn(line) != -1)
-			{
-				QStringList matches = re.capturedTexts();
-				if (matches.size() == 2)
-				{
-					QString m = matches.at(1);
-					leapFileExpiry.setTime_t(m.toUInt() - UNIXEPOCH);
-					qDebug() << "leap second file expiry time " << leapFileExpiry;
-				}
-			}
-		}
-		else if (line.startsWith("#")){// comments, specials we don't care about
-		}
-		else
-		{
-			if  (leapInfo.indexIn(line) != -1)
-			{
-				QStringList matches = leapInfo.capturedTexts();
-				if (matches.size() == 3)
-				{
-					QString m = matches.at(1);
-					lastLeap=m.toUInt();
-					m=matches.at(2);
-					deltaTAI=m.toUInt();
-					leapTable.push_back(new LeapInfo(lastLeap,deltaTAI));
-				}
-			}
-		}
-	}
-	
-	file.close();
-	QFileInfo fi(leapFile);
-	leapFileLastModified=fi.lastModified();
-	
-	QDateTime now = currentDateTime();
-	unsigned int ttnow = now.toTime_t();
-	
-	for (int i=leapTable.size()-1;i>=0;i--)
-	{
-		if (ttnow >= leapTable.at(i)->tleap - UNIXEPOCH)
-		{
-			leapSeconds = leapTable.at(i)->dttaiutc - DELTATAIGPS;
-			qDebug() << leapTable.at(i)->tleap << 
-				" delta_TAI= " << leapTable.at(i)->dttaiutc << " ls =" << leapSeconds;
-			break;
-		}
-	}
-	
-	leapsInitialized=true;
-	
+	leapFetcher->fetch(netManager,url,file);
 }
 
-
 bool TimeDisplay::readConfig(QString s)
 {
 	
@@ -1354,16 +1471,9 @@ bool TimeDisplay::readConfig(QString s)
 			timezone=elem.text().simplified();
 		else if (elem.tagName()=="timescale")
 		{
-			if (lc=="local")
-				timeScale=Local;
-			else if (lc=="utc")
-				timeScale=UTC;
-			else if (lc=="gps")
-				timeScale=GPS;
-			else if (lc=="unix")
-				timeScale=Unix;
-			else if (lc=="countdown")
-				timeScale=Countdown;
+			int scale = TimeScales::find(lc);
+			if (scale >= 0)
+				timeScale=scale;
 		}
 		else if (elem.tagName()=="todformat")
 		{
@@ -1380,10 +1490,59 @@ bool TimeDisplay::readConfig(QString s)
 		}
 		else if (elem.tagName()=="delay"){
 			displayDelay=elem.text().toInt();
-			wakeupTime = 1000+displayDelay;
+		}
+		else if (elem.tagName()=="subseconds"){
+			if (lc=="tenths")
+				secondsFormat=hhmmss_t;
+			else if (lc=="hundredths")
+				secondsFormat=hhmmss_hh;
+			else if (lc=="milliseconds")
+				secondsFormat=hhmmss_ms;
+			else
+				secondsFormat=hhmmss;
+		}
+		else if (elem.tagName()=="framerate"){
+			frameRate=lc.toInt();
+			if (frameRate < 1) frameRate=1;
+			if (frameRate > 100) frameRate=100;
 		}
 		else if (elem.tagName()=="blink")
 			blinkSeparator = (lc =="yes");
+		else if (elem.tagName()=="prerender")
+			prerender = (lc =="yes");
+		else if (elem.tagName()=="glyphcache")
+			glyphCache = (lc =="yes");
+		else if (elem.tagName()=="worldclock")
+		{
+			worldZones.clear();
+			worldLabels.clear();
+			QDomElement celem=elem.firstChildElement("zone");
+			while (!celem.isNull())
+			{
+				QString name=celem.text().simplified();
+				ZoneInfo zone;
+				if (zone.load(name)){ // read once, here, rather than on every tick
+					QString label=celem.attribute("label");
+					if (label.isEmpty())
+						label = name.section('/',-1).replace('_',' ');
+					worldZones.append(zone);
+					worldLabels.append(label);
+				}
+				celem=celem.nextSiblingElement("zone");
+			}
+		}
+		else if (elem.tagName()=="panel")
+		{
+			panelScales.clear();
+			QStringList names = lc.split(',',QString::SkipEmptyParts);
+			for (int i=0;i<names.size();i++){
+				int scale = TimeScales::find(names.at(i).trimmed());
+				if (scale >= 0)
+					panelScales.append(scale);
+				else
+					qWarning() << "TimeDisplay: unknown time scale in the panel" << names.at(i);
+			}
+		}
 		else if (elem.tagName()=="fontcolour"){
 			lc=elem.text();
 			currFontColourName=lc.simplified();
@@ -1408,11 +1567,9 @@ bool TimeDisplay::readConfig(QString s)
 				}
 				else if (celem.tagName() =="lightbkcolour"){
 					lightBkFontColourName = lc;
-					lightBkFontColour = QColor(lightBkFontColourName );
 				}
 				else if (celem.tagName() =="darkbkcolour"){
 					darkBkFontColourName = lc;
-					darkBkFontColour = QColor(darkBkFontColourName); 
 				}
 				celem=celem.nextSiblingElement();
 			}
@@ -1467,18 +1624,15 @@ bool TimeDisplay::readConfig(QString s)
 			while(!celem.isNull())
 			{
 				QString txt=celem.text().trimmed();
-				if (celem.tagName() == "local")
-					localTimeBanner=txt;
-				else if (celem.tagName() == "unix")
-					UnixBanner=txt;
-				else if (celem.tagName() == "gps")
-					GPSBanner=txt;
-				else if (celem.tagName() == "utc")
-					UTCBanner=txt;
-				else if (celem.tagName() == "countdown"){
+				if (celem.tagName() == "countdown"){
 					BeforeCountdownBanner="Until " + txt;
 					AfterCountdownBanner="Since " + txt;
 				}
+				else{
+					int scale = TimeScales::find(celem.tagName());
+					if (scale >= 0)
+						banners[scale]=txt;
+				}
 				celem=celem.nextSiblingElement();
 			}
 		}
@@ -1557,40 +1711,34 @@ bool TimeDisplay::readConfig(QString s)
 		leapFile = leapFileURL;
 	}
 	
+	invalidateDate();
 	return true;
 }
 
-void TimeDisplay::checkConfigFile(){
+void TimeDisplay::checkConfigFile(QDateTime lastModified){
 	
-	QFileInfo fi = QFileInfo(configFile);
-	if (fi.lastModified() > configLastModified){
+	if (lastModified > configLastModified){
 		qDebug() << "TimeDisplay::checkConfigFile()";
-		configLastModified = fi.lastModified();
+		configLastModified = lastModified;
 		if (readConfig(configFile)){
-			setWidgetStyleSheet();
+			tickScheduler->setOffset(displayDelay);
+			tickScheduler->setHalfTick(blinkSeparator,blinkDelay);
+			canvas->setPrerendering(prerender);
+			canvas->setGlyphAtlas(glyphCache);
+			setTheme();
 			setLogoImages();
 			
-			switch (timeScale){
-				case Local:setLocalTime();break;
-				case GPS:setGPSTime();break;
-				case Unix:setUnixTime();break;
-				case UTC:setUTCTime();break;
-				case Countdown:setCountdownTime();break;
-			}
-	
-			timezone.prepend(":");
-			setenv("TZ",timezone.toStdString().c_str(),1);
-			tzset();
+			configurePanel();
+			setTimeScale(timeScale);
+			setTimeZone();
 			
-			if (backgroundChanged) updateBackgroundImage(true);
+			configureHousekeeper(backgroundChanged);
 			
 			if (proxyServer != "" && proxyPort != -1){ // need minimal config for proxy server
 				
 				if (NULL==netManager){ // may have just configured it 
 					netManager = new QNetworkAccessManager(this);
 					netManager->setProxy(QNetworkProxy(QNetworkProxy::HttpProxy,proxyServer,proxyPort,proxyUser,proxyPassword)); // UNTESTED
-					connect(netManager, SIGNAL(finished(QNetworkReply*)),
-						this, SLOT(replyFinished(QNetworkReply*)));
 				}
 				else{ // valid new config and currently configured 
 					QNetworkProxy np = netManager->proxy();
@@ -1599,8 +1747,6 @@ void TimeDisplay::checkConfigFile(){
 						delete netManager;
 						netManager = new QNetworkAccessManager(this);
 						netManager->setProxy(QNetworkProxy(QNetworkProxy::HttpProxy,proxyServer,proxyPort,proxyUser,proxyPassword)); // UNTESTED
-						connect(netManager, SIGNAL(finished(QNetworkReply*)),
-							this, SLOT(replyFinished(QNetworkReply*)));
 					}
 				}
 			}
@@ -1609,20 +1755,63 @@ void TimeDisplay::checkConfigFile(){
 	}
 }
 
-void TimeDisplay::setWidgetStyleSheet()
+void TimeDisplay::setTheme()
 {
 	// mainly to execute changes in the config file 
-	fontColour=QColor(currFontColourName);
-	dimFontColour=fontColour.darker((int) (100*100/dimLevel));
-	QString txtColour;
-	txtColour.sprintf("color:rgba(%d,%d,%d,255)",
-			fontColour.red(),fontColour.green(),fontColour.blue());
-	
-	title->setStyleSheet(txtColour); // seems weird but this is the recommended way
-	tod->setStyleSheet(txtColour);  //  still seems weird but this is the recommended way
-	calText->setStyleSheet(txtColour);
-	date->setStyleSheet(txtColour);
-	imageInfo->setStyleSheet(txtColour);
+	theme.setTextColour(Theme::Normal,QColor(currFontColourName));
+	theme.setTextColour(Theme::LightBackground,QColor(lightBkFontColourName));
+	theme.setTextColour(Theme::DarkBackground,QColor(darkBkFontColourName));
+	theme.setDimLevel(dimLevel);
+	theme.setAutoAdjust(autoAdjustFontColour);
+	applyTheme();
+}
+
+void TimeDisplay::applyTheme()
+{
+	// The canvas only repaints what has actually changed
+	for (int e=0;e<ClockCanvas::NElements;e++)
+		canvas->setTextColour(e,theme.regionColour(e));
+	canvas->setPanelColour(theme.regionColour(PANELREGION));
+	canvas->setBackgroundColour(theme.backgroundColour());
+}
+
+void TimeDisplay::adjustTextColours()
+{
+	// Each element gets its colour from the background behind it. The table makes that a few lookups,
+	// so the rectangles are checked every tick, which catches the layout changing on a resize or a
+	// change of time scale as well as a new background.
+	QPoint origin = canvas->backgroundRect().topLeft(); // of the centred image
+	bool changed=false;
+	for (int r=0;r<=PANELREGION;r++){
+		QRect lr = (r == PANELREGION ? canvas->panelRect() : canvas->elementRect(r)).translated(-origin);
+		if (!adjustFontColour && lr == lumRects[r]) continue;
+		lumRects[r]=lr;
+		theme.setLuminance(r,lumTable.mean(lr)); // off the image, it's the normal colour
+		changed=true;
+	}
+	adjustFontColour=false;
+	if (changed)
+		applyTheme(); // a no-op unless a colour set has changed
+}
+
+QImage TimeDisplay::dimmedLogo(const QImage &logo,int level)
+{
+	QImage dim(logo);
+	QImage alpha;
+	if (dim.hasAlphaChannel())
+		alpha = dim.alphaChannel(); // OBSOLETE may break but pixel() does not return alpha in Qt4.6
+	
+	for (int i=0;i<dim.width();i++){
+		for (int j=0;j<dim.height();j++){
+			QColor col = QColor(dim.pixel(i,j));
+			QColor newcol = col.darker((int)(100*100/level));
+			QRgb val = newcol.rgba();
+			dim.setPixel(i,j,val);
+		}
+	}
+	if (dim.hasAlphaChannel())
+		dim.setAlphaChannel(alpha); // OBSOLETE
+	return dim;
 }
 
 void TimeDisplay::setLogoImages()
@@ -1630,29 +1819,12 @@ void TimeDisplay::setLogoImages()
 	if (logoChanged){
 		
 		qDebug() << "TimeDisplay::setLogoImages() changed";
-		QPixmap pm = QPixmap(logoImage);
-		logo->setPixmap(pm);
+		logo = QImage(logoImage);
+		canvas->setLogo(logo); // the canvas makes room for it below the time of day
 		
 		if (dimLogo) delete dimLogo;
 		
-		dimLogo = new QImage(logoImage);
-		QImage alpha;
-		if (dimLogo->hasAlphaChannel())
-			alpha = dimLogo->alphaChannel(); // OBSOLETE may break but pixel() does not return alpha in Qt4.6
-		
-		for (int i=0;i<dimLogo->width();i++){
-			for (int j=0;j<dimLogo->height();j++){
-				QColor col = QColor(dimLogo->pixel(i,j));
-				QColor newcol = col.darker((int)(100*100/dimLevel));
-				QRgb val = newcol.rgba();
-				dimLogo->setPixel(i,j,val);
-			}
-		}
-		if (dimLogo->hasAlphaChannel())
-			dimLogo->setAlphaChannel(alpha); // OBSOLETE
-			
-		date->setMinimumHeight(pm.height()+64);
-		//logoParentWidget->setFixedSize(pm.width(),pm.height());
+		dimLogo = new QImage(dimmedLogo(logo,dimLevel));
 	}
 	
 }		
@@ -1684,10 +1856,10 @@ void TimeDisplay::readBackgroundConfig(QDomElement elem)
 	
 	backgroundChanged=false;
 	
-	QString currCalImage=pickCalendarImage();
+	QString calItemText;
+	QString currCalImage=Housekeeper::pickCalendarImage(calendarItems,currentDateTime().date(),calItemText);
 	
-	while (!calendarItems.isEmpty())
-		delete calendarItems.takeFirst();
+	calendarItems.clear();
 
 	while (!elem.isNull())
 	{
@@ -1730,31 +1902,31 @@ void TimeDisplay::readBackgroundConfig(QDomElement elem)
 				backgroundChanged=true;
 		}
 		else if (elem.tagName() == "event"){
-			CalendarItem *calItem = new CalendarItem();
+			CalendarItem calItem;
 			QDomElement child = elem.firstChildElement();
 			
 			while (!child.isNull()){
 				if (child.tagName() == "startday"){
 					QString num = child.text().simplified();
-					calItem->startDay=num.toInt();
+					calItem.startDay=num.toInt();
 				}
 				if (child.tagName() == "startmonth"){
 					QString num = child.text().simplified();
-					calItem->startMonth=num.toInt();
+					calItem.startMonth=num.toInt();
 				}
 				else if (child.tagName() == "stopday"){
 					QString num = child.text().simplified();
-					calItem->stopDay=num.toInt();
+					calItem.stopDay=num.toInt();
 				}
 				else if (child.tagName() == "stopmonth"){
 					QString num = child.text().simplified();
-					calItem->stopMonth=num.toInt();
+					calItem.stopMonth=num.toInt();
 				}
 				else if (child.tagName() == "image"){
-					calItem->image = child.text().trimmed();
+					calItem.image = child.text().trimmed();
 				}
 				else if (child.tagName() == "description"){
-					calItem->description = child.text().trimmed();
+					calItem.description = child.text().trimmed();
 				}
 				child=child.nextSiblingElement();
 			}
@@ -1765,170 +1937,72 @@ void TimeDisplay::readBackgroundConfig(QDomElement elem)
 	
 	// since calendar image overrides, a simple test of whether the current image is the same as that according to the calendar
 	// is enough
-	QString im=pickCalendarImage();
-	if (im != currCalImage ){
-		calItemText=""; // in case there is now no calendar item
+	QString im=Housekeeper::pickCalendarImage(calendarItems,currentDateTime().date(),calItemText);
+	if (im != currCalImage )
 		backgroundChanged = true;
-	}
 }
 
-void TimeDisplay::setBackgroundFromCalendar()
-{
-	calItemText="";
-	QString im = pickCalendarImage();
-	if (!im.isEmpty()){
-		calText->setText(calItemText);	
-		currentImage=im;
-	}
-	calText->setVisible(!(calItemText.isEmpty()));
-}
-
-void TimeDisplay::setBackgroundFromSlideShow()
-{
-	currentImage=pickSlideShowImage();
-	nextSlideUpdate=currentDateTime();
-	int secs = nextSlideUpdate.time().minute()*60 +  nextSlideUpdate.time().second();
-	nextSlideUpdate=nextSlideUpdate.addSecs(3600*slideshowPeriod-secs);
-}
-
-
-void TimeDisplay::updateBackgroundImage(bool force)
+void TimeDisplay::setBackgroundImage(QString image,QImage im,QImage dimIm,LuminanceTable lum,QString calItemText,QString info)
 {
+	// The image has been loaded (and dimmed, and its luminance tabulated) on the housekeeping thread
 	
-	bool updateImage=force;
-	QDateTime now = currentDateTime();
-	
-	if (force){
-		qDebug() << "Forcing image update";
-		currentImage=defaultImage; // if a calendar item has become inactive, then this (and the next line) puts us in the right state
-		if (backgroundMode == Slideshow)
-			setBackgroundFromSlideShow();
-		setBackgroundFromCalendar(); // this overrides everything
-	}
-	else{ // determine whether the backgound image must be updated
-		QString im=currentImage;
-		if (backgroundMode==Fixed)
-			currentImage=defaultImage;
-		if (backgroundMode == Slideshow && (now > nextSlideUpdate)){
-			setBackgroundFromSlideShow();
-		}
-		setBackgroundFromCalendar();
-		updateImage = (im != currentImage);
-	}
+	canvas->setText(ClockCanvas::CalText,calItemText);
+	canvas->setTextVisible(ClockCanvas::CalText,!(calItemText.isEmpty()));
 	
-	lastBackgroundCheck = now;
+	forceUpdate();
 	
-	if (!updateImage) return;
+	currentImage=image;
 	
-	forceUpdate();
-
-	if (currentImage.isEmpty()){
-		//bkground->setStyleSheet("QLabel#Background {background: qlineargradient(x1: 0, y1: 0, x2: 0, y2: 1,"
-	//												 "stop: 0 #3c001e, stop: 0.2 #500130,"
-  //                         "stop: 0.8 #500130, stop: 1.0 #3c001e)}");
-		bkground->setStyleSheet("QLabel#Background {background-color:rgba(80,1,48,255)}");
-		bkground->setPixmap(QPixmap(""));
-		defaultImage="";
+	if (currentImage.isEmpty()){ // the canvas falls back to a plain background colour
+		bkImage=dimBkImage=QImage();
+		lumTable.clear();
+		canvas->setBackground(bkImage);
+		theme.setLuminance(-1);
+		applyTheme();
 	}
 	else{
-		bkground->setStyleSheet("* {background-color:rgba(0,0,0,0)}");
-		if (dimEnable){
-			// calculate and cache the dimmed image
-			if (NULL != dimImage)
-				delete dimImage;
-			dimImage = new QImage(currentImage);
-			for (int i=0;i<dimImage->width();i++){
-				for (int j=0;j<dimImage->height();j++){
-					QColor col = QColor(dimImage->pixel(i,j));
-					QColor newcol = col.darker((int)(100*100/dimLevel));
-					QRgb val = newcol.rgb();
-					dimImage->setPixel(i,j,val);
-				}
-			}
-			if (dimActive){
-				bkground->setPixmap(QPixmap::fromImage(*dimImage));
-				return;
-			}
+		// Convert once here, so that the canvas can blit the images without further conversion
+		bkImage=im.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+		dimBkImage=(dimIm.isNull() ? QImage() : dimIm.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+		lumTable=lum;
+		canvas->setText(ClockCanvas::ImageInfo,info);
+		adjustFontColour=true; // even if dimmed, so that the right colours are ready when it brightens
+		if (dimActive && !dimBkImage.isNull()){
+			canvas->setBackground(dimBkImage);
+			return;
 		}
-		bkground->setPixmap(QPixmap(currentImage));
-		imageInfo->setText(makeImageInfo(currentImage));
-		adjustFontColour=true;
+		canvas->setBackground(bkImage);
 	}
-
-	
 }
 
-QString TimeDisplay::pickCalendarImage()
+void TimeDisplay::configureHousekeeper(bool forceBackground)
 {
+	HousekeeperConfig cfg;
 	
-	QString res="";
-	QDate today=currentDateTime().date();
+	cfg.configFile=configFile;
 	
-	for (int i=0;i<calendarItems.length();++i){
-		CalendarItem *ci = calendarItems.at(i);
-		// calculations are easiest if we make QDates using the current year
-		QDate start(today.year(),ci->startMonth,ci->startDay);
-		QDate stop(today.year(),ci->stopMonth,ci->stopDay);
-		// Take care here with leap years - presumably specifying Feb 29 on a non-leap year results in an invalid date
-		if (start.isValid() && stop.isValid() && stop >= start){
-			if (today >= start && today <= stop){
-				qDebug() << "Picked calendar image" << ci->image;
-				QFileInfo fi = QFileInfo(ci->image);
-				if (fi.exists()){
-					res = ci->image;
-					calItemText=ci->description;
-				}
-				else
-					res="";
-				return res;
-			}
-		}
-	}
+	cfg.defaultImage=defaultImage;
+	cfg.backgroundMode=backgroundMode;
+	cfg.imagePath=imagePath;
+	cfg.slideshowPeriod=slideshowPeriod;
+	cfg.calendarItems=calendarItems;
+	cfg.dimEnable=dimEnable;
+	cfg.dimLevel=dimLevel;
+	cfg.forceBackground=forceBackground;
 	
-	return res;
-}
-
-QString TimeDisplay::pickSlideShowImage()
-{
-	QString res="";
-	QDir imPath(imagePath);
-	if (!imPath.exists()) return res;
+	cfg.lightLevelFile=lightLevelFile;
+	cfg.dimThreshold=dimThreshold;
 	
-	QStringList filters;
-	filters << "*.png" << "*.jpeg" << "*.jpg" << "*.tiff" << "*.bmp";
-	QFileInfoList imList=imPath.entryInfoList(filters,QDir::Files|QDir::Readable);
-	if (imList.length()==0) return res;
+	cfg.autoUpdateLeapFile=autoUpdateLeapFile;
+	cfg.leapFile=leapFile;
+	cfg.leapFileURL=leapFileURL;
 	
-	int r = trunc(imList.length()*(double) (random())/(double) (RAND_MAX));
-	if (r==imList.length()) r=imList.length()-1;
-	res= imList.at(r).absoluteFilePath();
-	qDebug() << "Picked slide show image " << res;
-	return res;
-}
-
-QString TimeDisplay::makeImageInfo(QString &fname)
-{
-	// Parses the image filename into a formatted string
-	// The image file name should be in the format AUTHOR__TITLE__whatever
-	// Anything before the first separator is taken to be the AUTHOR
-	// If the second separator is missing, then the title is left blank
-	QString info="";
-	QFileInfo fi(fname);
-	QStringList tmp=fi.baseName().split("__");
-	qDebug() << tmp;
-	if (2==tmp.size()){ // Author only
-		info=tmp.at(0);
-	}
-	else if (3==tmp.size()){
-		info=tmp.at(0)+" - "+tmp.at(1);
-	}
-	qDebug() << info;
-	return info;
+	QMetaObject::invokeMethod(housekeeper,"configure",Qt::QueuedConnection,Q_ARG(HousekeeperConfig,cfg));
 }
 
 QDateTime TimeDisplay::currentDateTime(){
 	// This is for debugging - it allows us to add some extra time to the current time to force events
-	QDateTime now = QDateTime::currentDateTime();
+	QDateTime now = clock->currentDateTime();
 	now=now.addSecs(timeOffset*60);
 	return now;
 }
@@ -28,33 +28,38 @@
 
 
 #include <QList>
+#include <QVector>
 #include <QWidget>
 #include <QDateTime>
+#include <QImage>
 #include <QtXml>
 
+#include "FramePacer.h"
+#include "LeapTable.h"
+#include "LuminanceTable.h"
+#include "Theme.h"
+#include "TimeFormatter.h"
+#include "ZoneInfo.h"
+
+#define DELTATAIGPS 19     // TAI-GPS; the leap second count is GPS-UTC
+
 class QAction;
 class QActionGroup;
 class QKeyEvent;
-class QLabel;
 class QMouseEvent;
 class QNetworkAccessManager;
-class QNetworkReply;
-class QTimer;
+class QThread;
 class QUdpSocket;
 
+class ClockCanvas;
+class ClockSource;
+class Housekeeper;
+class LeapFetcher;
+class LeapMonitor;
+class HousekeeperConfig;
 class PowerManager;
-
-class LeapInfo
-{
-public:
-    LeapInfo(unsigned int tl, unsigned int dt)
-    {
-        tleap=tl;
-        dttaiutc=dt;
-    }
-    unsigned int tleap; // NTP time
-    unsigned int dttaiutc; // delta TAI UTC
-};
+class TickScheduler;
+class TickStats;
 
 class CalendarItem
 {
@@ -73,9 +78,11 @@ class TimeDisplay : public QWidget
 public:
 
     TimeDisplay(QStringList &);
+    ~TimeDisplay();
 
-    enum TimeScale  { Local, UTC, Unix, GPS, Countdown };
-    enum TODFormat  {hhmm,hhmmss};
+    enum TimeScale  { Local, UTC, Unix, GPS, Countdown, TAI, TT, Galileo, BeiDou, GLONASS, JulianDate, ModifiedJulianDate,
+                      NTimeScales }; // see TimeScales.h
+    enum TODFormat  {hhmm,hhmmss,hhmmss_t,hhmmss_hh,hhmmss_ms}; // the last three with tenths, hundredths, ms
     enum HourFormat {TwelveHour,TwentyFourHour};
     enum BackgroundMode  {Fixed,Slideshow};
 		enum DimmingMethod {Software,VBETool};
@@ -83,27 +90,37 @@ public:
     enum DateFlags  {ISOdate=0x01,
                      PrettyDate=0x02,
                      MJD=0x04,
-                     GPSDayWeek=0x08,
-                     DOY=0x10
+                     GPSDayWeek=0x08, // or the week and day of the navigation system being shown
+                     DOY=0x10,
+                     FourYearDay=0x20 // GLONASS
                     };
 
+    // Formatting, as the display does it; bench/microbench times and checks these
+    bool readConfig(QString s);
+    const QString &formatTime(QDateTime &); // valid until the next call
+    const QString &formatTime(QDateTime &,int,int,int,bool); // with this time scale, TOD format, hour format and blinking
+    const QString &formatDate(QDateTime &);
+    const QString &formatDate(QDateTime &,int,int); // with this time scale and date format
+    void setCountdown(const QDateTime &);
+    bool showTime(QDateTime &); // whether the canvas will repaint
+    bool showDate(QDateTime &);
+    int  taiUTC();
+    static QImage dimmedLogo(const QImage &,int);
+
 protected slots:
 
     virtual void 	keyPressEvent (QKeyEvent *);
     virtual void 	mouseMoveEvent (QMouseEvent * );
     virtual void 	mousePressEvent (QMouseEvent * );
+    virtual bool 	eventFilter(QObject *,QEvent *);
 		
 private slots:
 
-    void updateTime();
+    void updateTime(qint64);
 
     void toggleFullScreen();
 
-    void setLocalTime();
-    void setUnixTime();
-    void setGPSTime();
-    void setUTCTime();
-		void setCountdownTime();
+    void setTimeScale(int);
 		
     void set12HourFormat();
     void set24HourFormat();
@@ -112,6 +129,9 @@ private slots:
     void toggleSeparatorBlinking();
     void setHHMMTODFormat();
     void setHHMMSSTODFormat();
+    void setTenthsTODFormat();
+    void setHundredthsTODFormat();
+    void setMillisecondsTODFormat();
 		
 		void saveSettings();
     void quit();
@@ -119,11 +139,20 @@ private slots:
     void createContextMenu(const QPoint &);
 
     void updateLeapSeconds();
-    void replyFinished(QNetworkReply*);
+    void setLeapSeconds(int);
+    void fetchLeapFile(QString,QString);
+    
+    void setBackgroundImage(QString,QImage,QImage,LuminanceTable,QString,QString);
+    void updateDimState(bool);
+    void checkConfigFile(QDateTime);
 
 		void readNTPDatagram();
 		
 		void setTimeOffset();
+		void stepSimulatedClock();
+		void setSimulationRate();
+		
+		void prerenderNextFrame();
 		
 private:
 
@@ -132,14 +161,32 @@ private:
     void createActions();
     void updateActions();
 
-    void showTime(QDateTime &);
-    void showDate(QDateTime &);
+    void setTODFormat(int);
+    int  fractionDigits();
+    int  fractionDigits(int);
+    static int framePeriod(int,int);
+    void applyTODFormat();
+    void setTickPeriod(int);
+    void fallBack();
+    
+    void formatTime(QDateTime &,int,QString &); // of the given time scale, into the string
+    void formatPanel(QDateTime &);
+    void formatZoneTime(qint64,ZoneInfo &,QString &);
+    void appendClock(int,int,int,int,int,bool,char);
+    qint64 toLocal(qint64);
+    static QDateTime utcDateTime(qint64);
+    static int msOfDay(qint64);
+    bool leapSecond(qint64);
+    qint64 dateRollover(qint64,qint64);
+    int  weekScale();
+    void setTimeZone();
+    void invalidateDate();
     void forceUpdate();
 		
-    void updateDimState();
     void updatePPSState();
 		
     void setTODFontSize();
+    QString widestReading(int);
     void setDateFontSize();
     void setTitleFontSize();
     void setCalTextFontSize();
@@ -147,30 +194,24 @@ private:
 		
     void setConfig(QString,QString);
 		
-    void fetchLeapSeconds();
-    void readLeapFile();
-		
-    void checkConfigFile();
-    void setWidgetStyleSheet();
+    void configureHousekeeper(bool);
+    void configurePanel();
+    void setTheme();
+    void applyTheme();
+    void adjustTextColours();
     void setLogoImages();
     
     void	writeNTPDatagram();
 		
-    bool readConfig(QString s);
     void readBackgroundConfig(QDomElement);
 		
-    void setBackgroundFromCalendar();
-    void setBackgroundFromSlideShow();
-    void updateBackgroundImage(bool force = false);
-		
-    QString pickCalendarImage();
-    QString pickSlideShowImage();
-		
-    QString makeImageInfo(QString &);
-		
     QDateTime currentDateTime();
 		
+    ClockSource    *clock;
+    LeapMonitor    *leapMonitor;
     PowerManager   *powerManager;
+    Housekeeper    *housekeeper;
+    QThread        *housekeeperThread;
 
     QDomDocument doc;
 		
@@ -184,16 +225,9 @@ private:
     QString proxyUser;
     QString proxyPassword;
     int leapSeconds; // the current value
-    QDateTime leapFileExpiry;
-    QDateTime lastLeapFileFetch;
-    QDateTime leapFileLastModified;
-    int leapFileCheckInterval;
     QString leapFile;
-    bool leapsInitialized;
-    QList<LeapInfo *> leapTable;
 
-    int displayDelay;
-    int wakeupTime;
+    int displayDelay; // offset of the update from the second boundary, in ms
     bool checkSync;
     QUdpSocket *ntpSocket;
     QDateTime  lastNTPReply;
@@ -202,14 +236,30 @@ private:
 		
     int timeScale;
     int TODFormat;
+    int secondsFormat; // the TOD format that local time and UTC revert to: hhmmss or one with fractions of a second
+    int frameRate;     // maximum, in Hz, when fractions of a second are shown
+    FramePacer framePacer;
+    uint lastSecond;   // of the last tick, so that once a second jobs aren't run on every frame
+    TimeFormatter fmt;
+    QString todText,dateText; // reused, so that formatting doesn't allocate
+    QVector<int> panelScales;  // shown below the time of day, read from the same tick
+    QVector<ZoneInfo> worldZones; // shown after the panel's time scales
+    QStringList worldLabels;
+    QVector<QString> panelText;
+    qint64 dateFrom,dateUntil;  // dateText is good for this range, in ms since the epoch
+    int dateScale,dateFlags;    // and this time scale and date format
     int hourFormat;
     int dateFormat;
     QString timezone;
+    ZoneInfo localZone; // timezone's, for converting ticks to local time
 
-    QString localTimeBanner,UTCBanner,UnixBanner,GPSBanner,BeforeCountdownBanner,AfterCountdownBanner;
+    QVector<QString> banners; // by time scale
+    QString BeforeCountdownBanner,AfterCountdownBanner;
 		
     QDateTime countdownDateTime;
 		
+    bool prerender; // draw the next frame ahead of time
+    bool glyphCache; // draw the time of day from pre-rasterised glyphs
     bool blinkSeparator;
     int  blinkDelay;
     QDateTime lastTimeCode;
@@ -234,21 +284,19 @@ private:
     int integrationPeriod;
 		
     QString currFontColourName;
-    QColor  fontColour;
-    QColor  dimFontColour;
-    QImage *dimImage;
+    Theme   theme;
+    QImage  bkImage,dimBkImage; // premultiplied, ready to blit
+    LuminanceTable lumTable;    // of bkImage, from the housekeeper
+    QRect   lumRects[Theme::MaxRegions]; // where each element's luminance was last taken
+    QImage  logo;
     QImage *dimLogo;
     bool autoAdjustFontColour;
     QString lightBkFontColourName,darkBkFontColourName;
-    QColor  lightBkFontColour,darkBkFontColour;
     bool adjustFontColour;
 		
     int backgroundMode;
-    QList<CalendarItem *> calendarItems;
+    QList<CalendarItem> calendarItems;
     QString imagePath;
-    QString calItemText;
-    QDateTime lastBackgroundCheck;
-    QDateTime nextSlideUpdate; 
     bool fullScreen;
     bool showImageInfo;
 		
@@ -257,13 +305,17 @@ private:
     bool backgroundChanged;
 		
     QNetworkAccessManager *netManager;
-    QTimer  *updateTimer;
-    QLabel  *bkground,*title,*tod,*date,*logo,*img,*calText,*imageInfo;
-    QWidget *logoParentWidget;
+    LeapFetcher *leapFetcher;
+    TickScheduler *tickScheduler;
+    TickStats     *tickStats;
+    qint64 tickDeadline; // monotonic time of the current tick's deadline, for measuring paint latency
+    bool   paintPending;
+    ClockCanvas *canvas;
     QAction *toggleFullScreenAction;
-    QAction *localTimeAction,*UnixTimeAction,*GPSTimeAction,*UTCTimeAction,*CountdownTimeAction;
+    QVector<QAction *> timeScaleActions;
     QAction *twelveHourFormatAction,*twentyFourHourFormatAction;
     QAction *sepBlinkingOnAction,*HHMMSSFormatAction,*HHMMFormatAction;
+    QAction *tenthsFormatAction,*hundredthsFormatAction,*millisecondsFormatAction;
     QAction *powerManAction;
     QAction *saveSettingsAction;
     QAction *quitAction;
@@ -272,6 +324,7 @@ private:
 
     QAction *testLeap;
     QAction *offsetTime;
+    QAction *stepClockAction,*clockRateAction;
 		
     int timeOffset; // in minutes
 };
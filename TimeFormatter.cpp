@@ -0,0 +1,148 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstring>
+
+#include <QDate>
+
+#include "TimeFormatter.h"
+
+static const char twoDigits[100][2]={
+	{'0','0'},{'0','1'},{'0','2'},{'0','3'},{'0','4'},{'0','5'},{'0','6'},{'0','7'},{'0','8'},{'0','9'},
+	{'1','0'},{'1','1'},{'1','2'},{'1','3'},{'1','4'},{'1','5'},{'1','6'},{'1','7'},{'1','8'},{'1','9'},
+	{'2','0'},{'2','1'},{'2','2'},{'2','3'},{'2','4'},{'2','5'},{'2','6'},{'2','7'},{'2','8'},{'2','9'},
+	{'3','0'},{'3','1'},{'3','2'},{'3','3'},{'3','4'},{'3','5'},{'3','6'},{'3','7'},{'3','8'},{'3','9'},
+	{'4','0'},{'4','1'},{'4','2'},{'4','3'},{'4','4'},{'4','5'},{'4','6'},{'4','7'},{'4','8'},{'4','9'},
+	{'5','0'},{'5','1'},{'5','2'},{'5','3'},{'5','4'},{'5','5'},{'5','6'},{'5','7'},{'5','8'},{'5','9'},
+	{'6','0'},{'6','1'},{'6','2'},{'6','3'},{'6','4'},{'6','5'},{'6','6'},{'6','7'},{'6','8'},{'6','9'},
+	{'7','0'},{'7','1'},{'7','2'},{'7','3'},{'7','4'},{'7','5'},{'7','6'},{'7','7'},{'7','8'},{'7','9'},
+	{'8','0'},{'8','1'},{'8','2'},{'8','3'},{'8','4'},{'8','5'},{'8','6'},{'8','7'},{'8','8'},{'8','9'},
+	{'9','0'},{'9','1'},{'9','2'},{'9','3'},{'9','4'},{'9','5'},{'9','6'},{'9','7'},{'9','8'},{'9','9'}
+};
+
+static const int hour12[24]={12,1,2,3,4,5,6,7,8,9,10,11,12,1,2,3,4,5,6,7,8,9,10,11};
+
+TimeFormatter::TimeFormatter()
+{
+	len=0;
+	// The names depend on the locale, so they're made the same way that the date used to be
+	for (int m=1;m<=12;m++){
+		monthNames[m-1]=QDate(2000,m,1).toString("MMM");
+		monthNames[m-1].remove('.'); // Qt5 adds a period after the month name in some locales
+	}
+}
+
+void TimeFormatter::clear()
+{
+	len=0;
+}
+
+void TimeFormatter::append(char c)
+{
+	if (len < Capacity)
+		buf[len++]=QLatin1Char(c);
+}
+
+void TimeFormatter::append(const char *s)
+{
+	while (*s)
+		append(*s++);
+}
+
+void TimeFormatter::append(const QString &s)
+{
+	for (int i=0;i<s.size() && len < Capacity;i++)
+		buf[len++]=s.at(i);
+}
+
+void TimeFormatter::appendTwoDigits(int n)
+{
+	if (n < 0 || n > 99){
+		appendNumber(n);
+		return;
+	}
+	append(twoDigits[n][0]);
+	append(twoDigits[n][1]);
+}
+
+void TimeFormatter::appendFourDigits(int n)
+{
+	if (n < 0 || n > 9999){
+		appendNumber(n);
+		return;
+	}
+	appendTwoDigits(n/100);
+	appendTwoDigits(n%100);
+}
+
+void TimeFormatter::appendNumber(qint64 n)
+{
+	char tmp[24];
+	int i=sizeof(tmp);
+	bool negative = (n < 0);
+	quint64 u = (negative ? -(quint64) n : (quint64) n);
+	do{
+		tmp[--i] = '0' + u%10;
+		u /= 10;
+	} while (u);
+	if (negative) tmp[--i]='-';
+	while (i < (int) sizeof(tmp))
+		append(tmp[i++]);
+}
+
+void TimeFormatter::appendFraction(int msec,int digits)
+{
+	if (digits <= 0) return;
+	append('.');
+	append('0' + msec/100);
+	if (digits > 1) append('0' + (msec/10)%10);
+	if (digits > 2) append('0' + msec%10);
+}
+
+void TimeFormatter::appendMonthName(int m)
+{
+	if (m < 1 || m > 12) return;
+	const QString &name = monthNames[m-1];
+	for (int i=0;i<name.size() && len < Capacity;i++)
+		buf[len++]=name.at(i);
+}
+
+int TimeFormatter::size()
+{
+	return len;
+}
+
+void TimeFormatter::copyTo(QString &s)
+{
+	if (s.size() == len && memcmp(s.constData(),buf,len*sizeof(QChar)) == 0) return; // unchanged
+	s.resize(len);
+	memcpy(s.data(),buf,len*sizeof(QChar));
+}
+
+int TimeFormatter::twelveHour(int hr)
+{
+	if (hr < 0 || hr > 23) return hr;
+	return hour12[hr];
+}
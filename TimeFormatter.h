@@ -0,0 +1,66 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __TIME_FORMATTER_H_
+#define __TIME_FORMATTER_H_
+
+#include <QChar>
+#include <QString>
+
+// Builds the time of day and date lines in a fixed buffer, from precomputed tables, so that
+// formatting a tick doesn't allocate. The result is copied into a QString which is reused from one
+// tick to the next.
+
+class TimeFormatter
+{
+	public:
+	
+		enum {Capacity=64}; // characters; anything more is dropped
+		
+		TimeFormatter();
+		
+		void clear();
+		void append(char);
+		void append(const char *);
+		void append(const QString &);
+		void appendTwoDigits(int);  // 00 to 99, so a leap second's 60 is fine
+		void appendFourDigits(int); // years
+		void appendNumber(qint64);
+		void appendFraction(int,int); // ms, truncated to the given number of digits
+		void appendMonthName(int);    // 1 to 12, as QDate::toString("MMM") gives it
+		
+		int size();
+		void copyTo(QString &); // in place, so this only allocates if the string is shared or too short
+		
+		static int twelveHour(int); // 0 to 23 -> 1 to 12
+		
+	private:
+	
+		QChar buf[Capacity];
+		int len;
+		QString monthNames[12];
+};
+
+#endif
@@ -0,0 +1,47 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "TimeScales.h"
+
+constexpr ScaleDescriptor TimeScales::table[];
+
+static constexpr bool inOrder(int s)
+{
+	return s == TimeScales::count() || (TimeScales::at(s).scale == s && inOrder(s+1));
+}
+
+static_assert(inOrder(0),"TimeScales::table has to be in TimeDisplay::TimeScale order");
+static_assert(Scale<TimeDisplay::GPS>::offset() == -DELTATAIGPS*1000,"GPS is DELTATAIGPS behind TAI");
+static_assert(Scale<TimeDisplay::Galileo>::offset() == Scale<TimeDisplay::GPS>::offset(),"Galileo is steered to GPS");
+static_assert((Scale<TimeDisplay::Galileo>::epoch() - Scale<TimeDisplay::GPS>::epoch()) == 1024*604800,
+	"Galileo weeks start at GPS week 1024");
+
+int TimeScales::find(const QString &name)
+{
+	for (int s=0;s<count();s++)
+		if (name.compare(table[s].name,Qt::CaseInsensitive) == 0)
+			return s;
+	return -1;
+}
@@ -0,0 +1,118 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __TIME_SCALES_H_
+#define __TIME_SCALES_H_
+
+#include <QString>
+
+#include "TimeDisplay.h"
+
+// Everything the display needs to know about a time scale, fixed at compile time. A scale's reading
+// is UTC, plus TAI-UTC if it's atomic, plus a fixed offset, counted from its epoch. Adding a scale
+// is a value in TimeDisplay::TimeScale and a row in TimeScales::table.
+
+class ScaleDescriptor
+{
+	public:
+	
+		// How the time of day is shown
+		enum Style {LocalTime,   // hh:mm:ss in the local time zone
+		            TimeOfDay,   // hh:mm:ss of the scale itself, with 60 s in a leap second unless it's atomic
+		            Seconds,     // since the epoch
+		            WeekSeconds, // into the week, with weeks counted from the epoch
+		            Days,        // since the epoch, to five decimal places
+		            Interval     // seconds to or from the countdown time
+		           };
+		
+		int scale;            // its TimeDisplay::TimeScale, which is its place in the table
+		const char *name;     // in the config file, where case doesn't matter
+		const char *menuText;
+		const char *banner;   // the default
+		int style;
+		int dateFormat;       // the date line the scale starts with
+		qint64 epoch;         // where counts start, as a Unix time labelled in the scale itself
+		qint64 offset;        // in ms, from TAI for an atomic scale and from UTC otherwise
+		bool atomic;          // no leap seconds
+		bool ownCalendar;     // the date line is the scale's own, rather than the local date
+		const char *widest;   // the widest reading, for sizing the font when it isn't hh:mm:ss
+		
+		constexpr bool showsTimeOfDay() const {return style == LocalTime || style == TimeOfDay;}
+		constexpr qint64 label(qint64 utc,int taiUTC) const // utc in ms since the Unix epoch
+			{return utc + (atomic ? taiUTC*1000LL : 0) + offset;}
+		constexpr qint64 reading(qint64 utc,int taiUTC) const // in ms since the scale's epoch
+			{return label(utc,taiUTC) - epoch*1000;}
+};
+
+class TimeScales
+{
+	public:
+	
+		static constexpr int count() {return TimeDisplay::NTimeScales;}
+		static constexpr const ScaleDescriptor &at(int s) {return table[s];}
+		static int find(const QString &); // by name, or -1
+		
+		static constexpr ScaleDescriptor table[TimeDisplay::NTimeScales] = {
+			{TimeDisplay::Local,"Local","Local time","Local time",
+				ScaleDescriptor::LocalTime,TimeDisplay::PrettyDate,0,0,false,false,""},
+			{TimeDisplay::UTC,"UTC","UTC time","Coordinated Universal Time",
+				ScaleDescriptor::TimeOfDay,TimeDisplay::MJD|TimeDisplay::DOY,0,0,false,false,""},
+			{TimeDisplay::Unix,"UNIX","Unix time","Unix time",
+				ScaleDescriptor::Seconds,TimeDisplay::MJD|TimeDisplay::DOY,0,0,false,false,"1360930340"},
+			{TimeDisplay::GPS,"GPS","GPS time","GPS time", // 1980-01-06
+				ScaleDescriptor::WeekSeconds,TimeDisplay::GPSDayWeek,315964800,-19000,true,false,"99:99:99"}, // looks too big if you use TOW
+			{TimeDisplay::Countdown,"Countdown","Countdown time","Until ...",
+				ScaleDescriptor::Interval,TimeDisplay::PrettyDate,0,0,false,false,"999999999 s"},
+			{TimeDisplay::TAI,"TAI","TAI","International Atomic Time",
+				ScaleDescriptor::TimeOfDay,TimeDisplay::MJD|TimeDisplay::DOY,0,0,true,true,""},
+			{TimeDisplay::TT,"TT","TT","Terrestrial Time",
+				ScaleDescriptor::TimeOfDay,TimeDisplay::MJD|TimeDisplay::DOY,0,32184,true,true,""},
+			{TimeDisplay::Galileo,"Galileo","Galileo time","Galileo System Time", // 1999-08-22, GPS week 1024
+				ScaleDescriptor::WeekSeconds,TimeDisplay::GPSDayWeek,935280000,-19000,true,false,"99:99:99"},
+			{TimeDisplay::BeiDou,"BeiDou","BeiDou time","BeiDou Time", // 2006-01-01, when TAI-UTC was 33 s
+				ScaleDescriptor::WeekSeconds,TimeDisplay::GPSDayWeek,1136073600,-33000,true,false,"99:99:99"},
+			{TimeDisplay::GLONASS,"GLONASS","GLONASS time","GLONASS Time", // UTC(SU)+3h; four year periods from 1996
+				ScaleDescriptor::TimeOfDay,TimeDisplay::FourYearDay,820454400,3*3600000,false,true,""},
+			{TimeDisplay::JulianDate,"JD","Julian Date","Julian Date", // JD 2440587.5 at the Unix epoch
+				ScaleDescriptor::Days,TimeDisplay::MJD,-210866760000LL,0,false,true,"2457754.50000"},
+			{TimeDisplay::ModifiedJulianDate,"MJD","Modified Julian Date","Modified Julian Date", // MJD 40587
+				ScaleDescriptor::Days,TimeDisplay::ISOdate|TimeDisplay::DOY,-3506716800LL,0,false,true,"57754.50000"}
+		};
+};
+
+// For code that knows which scale it wants, so that the arithmetic folds away
+
+template <int S> class Scale
+{
+	public:
+	
+		static constexpr qint64 epoch() {return TimeScales::table[S].epoch;}
+		static constexpr qint64 offset() {return TimeScales::table[S].offset;}
+		static constexpr bool atomic() {return TimeScales::table[S].atomic;}
+		static constexpr qint64 label(qint64 utc,int taiUTC) {return TimeScales::table[S].label(utc,taiUTC);}
+		static constexpr qint64 reading(qint64 utc,int taiUTC) {return TimeScales::table[S].reading(utc,taiUTC);}
+};
+
+#endif
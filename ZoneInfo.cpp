@@ -0,0 +1,453 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+#include <QDebug>
+#include <QFile>
+
+#include "ZoneInfo.h"
+
+static const qint64 BigBang = std::numeric_limits<qint64>::min();
+static const qint64 Forever = std::numeric_limits<qint64>::max();
+
+static qint64 floorDiv(qint64 a,qint64 b)
+{
+	return (a >= 0 ? a/b : -((-a + b - 1)/b));
+}
+
+static bool isLeapYear(int y)
+{
+	return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+static int daysInMonth(int y,int m)
+{
+	static const int days[12]={31,28,31,30,31,30,31,31,30,31,30,31};
+	return days[m-1] + (m == 2 && isLeapYear(y) ? 1 : 0);
+}
+
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar, and back to the year
+// (after Howard Hinnant's days_from_civil() and civil_from_days())
+static qint64 daysFromCivil(int y,int m,int d)
+{
+	y -= (m <= 2);
+	qint64 era = floorDiv(y,400);
+	int yoe = y - era*400;
+	int doy = (153*(m + (m > 2 ? -3 : 9)) + 2)/5 + d-1;
+	int doe = yoe*365 + yoe/4 - yoe/100 + doy;
+	return era*146097 + doe - 719468;
+}
+
+static int yearOf(qint64 days)
+{
+	days += 719468;
+	qint64 era = floorDiv(days,146097);
+	int doe = days - era*146097;
+	int yoe = (doe - doe/1460 + doe/36524 - doe/146096)/365;
+	int doy = doe - (365*yoe + yoe/4 - yoe/100);
+	int mp = (5*doy + 2)/153;
+	return yoe + era*400 + (mp >= 10 ? 1 : 0);
+}
+
+static qint64 be32(const uchar *p)
+{
+	return (qint32) (((quint32) p[0] << 24) | ((quint32) p[1] << 16) | ((quint32) p[2] << 8) | p[3]);
+}
+
+static qint64 be64(const uchar *p)
+{
+	return (qint64) (((quint64) (quint32) be32(p) << 32) | (quint32) be32(p+4));
+}
+
+//
+// ZoneOffset
+//
+
+ZoneOffset::ZoneOffset()
+{
+	utcOffset=0;
+	dst=false;
+	validFrom=validUntil=0; // so that the first lookup isn't skipped
+}
+
+//
+// PosixRule
+//
+
+static bool parseNumber(const char *&p,int &n)
+{
+	if (*p < '0' || *p > '9') return false;
+	n=0;
+	while (*p >= '0' && *p <= '9' && n < 100000)
+		n = n*10 + (*p++ - '0');
+	return true;
+}
+
+static bool parseName(const char *&p,QString &name)
+{
+	// three or more letters, or anything in angle brackets, like <+0530>
+	const char *q=p;
+	if (*p == '<'){
+		while (*p && *p != '>') p++;
+		if (*p != '>') return false;
+		name = QString::fromLatin1(q+1,p-q-1);
+		p++;
+		return !name.isEmpty();
+	}
+	while ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z')) p++;
+	name = QString::fromLatin1(q,p-q);
+	return p-q >= 3;
+}
+
+static bool parseTime(const char *&p,int &secs)
+{
+	// [+-]hh[:mm[:ss]], with hours up to 167 as RFC 8536 allows
+	int sign=1;
+	if (*p == '+' || *p == '-')
+		sign = (*p++ == '-' ? -1 : 1);
+	int h,m=0,s=0;
+	if (!parseNumber(p,h) || h > 167) return false;
+	if (*p == ':'){
+		p++;
+		if (!parseNumber(p,m) || m > 59) return false;
+		if (*p == ':'){
+			p++;
+			if (!parseNumber(p,s) || s > 59) return false;
+		}
+	}
+	secs = sign*(h*3600 + m*60 + s);
+	return true;
+}
+
+PosixRule::PosixRule()
+{
+	stdOffset=dstOffset=0;
+	hasDST=valid=false;
+}
+
+bool PosixRule::parse(const QString &rule)
+{
+	valid=hasDST=false;
+	QByteArray ba = rule.toLatin1();
+	const char *p = ba.constData();
+	
+	// Offsets are hours west of Greenwich here, so the signs are flipped
+	if (!parseName(p,stdName) || !parseTime(p,stdOffset)) return false;
+	stdOffset = -stdOffset;
+	if (*p == 0){ // no daylight saving
+		valid=true;
+		return true;
+	}
+	if (!parseName(p,dstName)) return false;
+	dstOffset = stdOffset + 3600;
+	if (*p != ','){
+		if (!parseTime(p,dstOffset)) return false;
+		dstOffset = -dstOffset;
+	}
+	if (*p++ != ',' || !parseChange(p,start)) return false;
+	if (*p++ != ',' || !parseChange(p,end)) return false;
+	if (*p) return false;
+	hasDST=valid=true;
+	return true;
+}
+
+bool PosixRule::parseChange(const char *&p,Change &c)
+{
+	// Jn, n or Mm.w.d, then an optional /time, which defaults to 02:00
+	c.day=c.week=c.month=0;
+	c.time=7200;
+	if (*p == 'J'){
+		p++;
+		c.form=Julian;
+		if (!parseNumber(p,c.day) || c.day < 1 || c.day > 365) return false;
+	}
+	else if (*p == 'M'){
+		p++;
+		c.form=MonthWeekDay;
+		if (!parseNumber(p,c.month) || c.month < 1 || c.month > 12 || *p++ != '.') return false;
+		if (!parseNumber(p,c.week) || c.week < 1 || c.week > 5 || *p++ != '.') return false;
+		if (!parseNumber(p,c.day) || c.day > 6) return false;
+	}
+	else{
+		c.form=ZeroJulian;
+		if (!parseNumber(p,c.day) || c.day > 365) return false;
+	}
+	if (*p == '/'){
+		p++;
+		if (!parseTime(p,c.time)) return false;
+	}
+	return true;
+}
+
+qint64 PosixRule::changeAt(const Change &c,int year,int offset)
+{
+	qint64 day=0;
+	switch (c.form){
+		case Julian: // Feb 29 is never counted
+			day = daysFromCivil(year,1,1) + c.day-1 + (isLeapYear(year) && c.day >= 60 ? 1 : 0);
+			break;
+		case ZeroJulian:
+			day = daysFromCivil(year,1,1) + c.day;
+			break;
+		case MonthWeekDay: // day d of week w, where week 5 is the last
+		{
+			qint64 first = daysFromCivil(year,c.month,1);
+			int dow = (int) (((first + 4) % 7 + 7) % 7); // 1970-01-01 was a Thursday
+			int d = (c.day - dow + 7) % 7 + (c.week-1)*7;
+			if (d >= daysInMonth(year,c.month)) d -= 7;
+			day = first + d;
+			break;
+		}
+	}
+	return day*86400 + c.time - offset;
+}
+
+ZoneOffset PosixRule::lookup(qint64 t)
+{
+	ZoneOffset z;
+	z.validFrom=BigBang;
+	z.validUntil=Forever;
+	z.utcOffset=stdOffset;
+	z.abbreviation=stdName;
+	if (!valid || !hasDST) return z;
+	
+	// The changes in the years either side of t. Daylight saving starts in standard time and ends in
+	// daylight time. Where an end and a start coincide, as in all year daylight saving, the start wins.
+	int year = yearOf(floorDiv(t + stdOffset,86400));
+	qint64 at[6];
+	bool toDST[6];
+	int n=0;
+	for (int y=year-1;y<=year+1;y++){
+		at[n]=changeAt(start,y,stdOffset);
+		toDST[n++]=true;
+		at[n]=changeAt(end,y,dstOffset);
+		toDST[n++]=false;
+	}
+	for (int i=1;i<n;i++) // in time order, keeping the order of equal ones
+		for (int j=i;j>0 && at[j-1] > at[j];j--){
+			std::swap(at[j-1],at[j]);
+			std::swap(toDST[j-1],toDST[j]);
+		}
+	
+	int i=n-1;
+	while (i > 0 && at[i] > t) i--;
+	if (at[i] > t) // can't happen, since t is in the middle year
+		return z;
+	z.dst=toDST[i];
+	z.validFrom=at[i];
+	z.validUntil=(i+1 < n ? at[i+1] : Forever);
+	z.utcOffset=(z.dst ? dstOffset : stdOffset);
+	z.abbreviation=(z.dst ? dstName : stdName);
+	return z;
+}
+
+//
+// ZoneInfo
+//
+
+ZoneInfo::ZoneInfo()
+{
+	valid=false;
+}
+
+bool ZoneInfo::load(const QString &zone)
+{
+	zoneName=zone;
+	if (zone.contains(".."))
+		return fail("bad zone name");
+	QFile f(zone.startsWith('/') ? zone : zoneDir() + "/" + zone);
+	if (!f.open(QIODevice::ReadOnly))
+		return fail("can't open " + f.fileName());
+	QByteArray ba = f.readAll(); // a few kB at most
+	return parse((const uchar *) ba.constData(),ba.size());
+}
+
+bool ZoneInfo::parse(const uchar *p,qint64 n)
+{
+	valid=false;
+	transitions.clear();
+	transitionTypes.clear();
+	types.clear();
+	footer=PosixRule();
+	current=ZoneOffset();
+	
+	const int headerSize=44;
+	if (n < headerSize || memcmp(p,"TZif",4) != 0)
+		return fail("not a TZif file");
+	int version = p[4];
+	const uchar *h = p;
+	qint64 isutcnt=be32(h+20),isstdcnt=be32(h+24),leapcnt=be32(h+28),timecnt=be32(h+32),typecnt=be32(h+36),charcnt=be32(h+40);
+	int timeSize=4;
+	if (version >= '2'){ // skip the version 1 data, since the second header has 64-bit times
+		qint64 v1 = timecnt*5 + typecnt*6 + charcnt + leapcnt*8 + isstdcnt + isutcnt;
+		if (v1 < 0 || 2*headerSize + v1 > n)
+			return fail("truncated");
+		h = p + headerSize + v1;
+		if (memcmp(h,"TZif",4) != 0)
+			return fail("no second header");
+		isutcnt=be32(h+20);isstdcnt=be32(h+24);leapcnt=be32(h+28);timecnt=be32(h+32);typecnt=be32(h+36);charcnt=be32(h+40);
+		timeSize=8;
+	}
+	const uchar *q = h + headerSize;
+	const uchar *end = p + n;
+	qint64 size = timecnt*(timeSize+1) + typecnt*6 + charcnt + leapcnt*(timeSize+4) + isstdcnt + isutcnt;
+	if (timecnt < 0 || typecnt < 0 || charcnt < 0 || leapcnt < 0 || size < 0 || size > end - q)
+		return fail("truncated");
+	if (typecnt == 0 || typecnt > 256 || charcnt == 0)
+		return fail("no local time types");
+	if (leapcnt > 0) // the right/ zones count leap seconds, which the system clock doesn't
+		return fail("has leap seconds");
+	
+	transitions.reserve(timecnt);
+	for (int i=0;i<timecnt;i++,q += timeSize){
+		qint64 t = (timeSize == 8 ? be64(q) : be32(q));
+		if (i > 0 && t <= transitions.last())
+			return fail("transitions out of order");
+		transitions.append(t);
+	}
+	transitionTypes.reserve(timecnt);
+	for (int i=0;i<timecnt;i++,q++){
+		if (*q >= typecnt)
+			return fail("bad transition type");
+		transitionTypes.append(*q);
+	}
+	const uchar *chars = q + typecnt*6;
+	for (int i=0;i<typecnt;i++,q += 6){
+		LocalTimeType ltt;
+		ltt.utcOffset=be32(q);
+		ltt.dst=(q[4] != 0);
+		int idx=q[5];
+		if (idx >= charcnt)
+			return fail("bad abbreviation");
+		int len=0;
+		while (idx+len < charcnt && chars[idx+len]) len++;
+		ltt.abbreviation=QString::fromLatin1((const char *) chars+idx,len);
+		types.append(ltt);
+	}
+	q = h + headerSize + size;
+	
+	// Version 2+ ends with a POSIX TZ string for times after the last transition
+	if (version >= '2' && q < end && *q == '\n'){
+		const uchar *e = q+1;
+		while (e < end && *e != '\n') e++;
+		if (e < end && e > q+1 && !footer.parse(QString::fromLatin1((const char *) q+1,e-q-1)))
+			qWarning() << "ZoneInfo:" << zoneName << "has a TZ string that can't be parsed";
+	}
+	valid=true;
+	return true;
+}
+
+bool ZoneInfo::isValid()
+{
+	return valid;
+}
+
+QString ZoneInfo::name()
+{
+	return zoneName;
+}
+
+QString ZoneInfo::error()
+{
+	return err;
+}
+
+const ZoneOffset &ZoneInfo::at(qint64 ms)
+{
+	qint64 t = floorDiv(ms,1000);
+	if (!current.contains(t))
+		current=lookup(t);
+	return current;
+}
+
+qint64 ZoneInfo::toLocal(qint64 ms)
+{
+	return ms + at(ms).utcOffset*1000LL;
+}
+
+qint64 ZoneInfo::nextRollover(qint64 ms)
+{
+	// Local midnight at the current offset, unless the offset changes first, in which case
+	// the caller asks again then. That also covers a transition which skips midnight.
+	const qint64 msPerDay=86400000;
+	const ZoneOffset &z = at(ms);
+	qint64 midnight = (floorDiv(ms + z.utcOffset*1000LL,msPerDay) + 1)*msPerDay - z.utcOffset*1000LL;
+	if (z.validUntil < midnight/1000)
+		return z.validUntil*1000;
+	return midnight;
+}
+
+ZoneOffset ZoneInfo::lookup(qint64 t)
+{
+	int n = transitions.size();
+	if (!valid)
+		return offsetOf(-1,BigBang,Forever);
+	if (n == 0)
+		return (footer.isValid() ? footer.lookup(t) : offsetOf(0,BigBang,Forever));
+	
+	// the last transition at or before t; before the first one, the first type applies
+	int i = std::upper_bound(transitions.constBegin(),transitions.constEnd(),t) - transitions.constBegin() - 1;
+	if (i < 0)
+		return offsetOf(0,BigBang,transitions.first());
+	if (i == n-1 && footer.isValid()){
+		ZoneOffset z = footer.lookup(t);
+		z.validFrom = qMax(z.validFrom,transitions.last());
+		return z;
+	}
+	return offsetOf(transitionTypes.at(i),transitions.at(i),i+1 < n ? transitions.at(i+1) : Forever);
+}
+
+QString ZoneInfo::zoneDir()
+{
+	QByteArray dir = qgetenv("TZDIR");
+	return (dir.isEmpty() ? QString(ZONEINFODIR) : QString::fromLocal8Bit(dir));
+}
+
+bool ZoneInfo::fail(const QString &msg)
+{
+	err=msg;
+	valid=false;
+	qWarning() << "ZoneInfo:" << zoneName << msg;
+	return false;
+}
+
+ZoneOffset ZoneInfo::offsetOf(int type,qint64 from,qint64 until)
+{
+	ZoneOffset z;
+	if (type >= 0 && type < types.size()){
+		const LocalTimeType &ltt = types.at(type);
+		z.utcOffset=ltt.utcOffset;
+		z.dst=ltt.dst;
+		z.abbreviation=ltt.abbreviation;
+	}
+	else
+		z.abbreviation="UTC";
+	z.validFrom=from;
+	z.validUntil=until;
+	return z;
+}
@@ -0,0 +1,131 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __ZONE_INFO_H_
+#define __ZONE_INFO_H_
+
+#include <QString>
+#include <QVector>
+
+#define ZONEINFODIR "/usr/share/zoneinfo" // unless TZDIR is set
+
+// A stretch of time over which a zone's offset from UTC doesn't change
+
+class ZoneOffset
+{
+	public:
+	
+		ZoneOffset();
+		
+		bool contains(qint64 t) {return t >= validFrom && t < validUntil;}
+		
+		int utcOffset;        // in s, east of Greenwich
+		bool dst;
+		QString abbreviation; // eg AEDT
+		qint64 validFrom,validUntil; // in s since the Unix epoch
+};
+
+// The POSIX TZ string at the end of a version 2+ TZif file, eg AEST-10AEDT,M10.1.0,M4.1.0/3, which gives
+// the offset after the last transition in the file
+
+class PosixRule
+{
+	public:
+	
+		PosixRule();
+		
+		bool parse(const QString &);
+		bool isValid() {return valid;}
+		ZoneOffset lookup(qint64); // s since the Unix epoch
+		
+	private:
+	
+		class Change
+		{
+			public:
+				int form;  // Julian (1 to 365, no Feb 29), ZeroJulian (0 to 365) or MonthWeekDay
+				int day,week,month;
+				int time;  // s after local midnight, which can be negative or past 24 h
+		};
+		
+		enum {Julian,ZeroJulian,MonthWeekDay};
+		
+		bool parseChange(const char *&,Change &);
+		qint64 changeAt(const Change &,int,int); // the UTC instant it happens in a year, given the offset in force before it
+		
+		QString stdName,dstName;
+		int stdOffset,dstOffset; // east of Greenwich
+		bool hasDST;
+		Change start,end;
+		bool valid;
+};
+
+// A time zone read from a TZif file (RFC 8536), for converting UTC to local time without going through
+// the process-wide TZ. Lookups are cached until the next transition, so on most ticks at() is a compare.
+
+class ZoneInfo
+{
+	public:
+	
+		ZoneInfo();
+		
+		bool load(const QString &); // a name like Europe/London, or a path
+		bool parse(const uchar *,qint64);
+		
+		bool isValid();
+		QString name();
+		QString error();
+		
+		const ZoneOffset &at(qint64); // ms since the Unix epoch; cached
+		ZoneOffset lookup(qint64);    // s since the Unix epoch; searches
+		qint64 toLocal(qint64);       // ms since the epoch, labelled with local time
+		qint64 nextRollover(qint64);  // ms since the epoch of the next local midnight or transition
+		
+		static QString zoneDir();
+		
+	private:
+	
+		class LocalTimeType
+		{
+			public:
+				int utcOffset;
+				bool dst;
+				QString abbreviation;
+		};
+		
+		bool fail(const QString &);
+		ZoneOffset offsetOf(int,qint64,qint64);
+		
+		QString zoneName;
+		QVector<qint64> transitions; // s since the Unix epoch
+		QVector<int> transitionTypes;
+		QVector<LocalTimeType> types;
+		PosixRule footer;
+		ZoneOffset current;
+		bool valid;
+		QString err;
+};
+
+#endif
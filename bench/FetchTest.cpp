@@ -0,0 +1,219 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// fetchtest - checks LeapFetcher against a stub HTTP server
+//
+// Runs through a fresh download, a conditional request that the server answers with 304, and
+// downloads that must be rejected: a truncated body, a bad #h hash, a body far over the size cap
+// and a server that never answers. After each of those, the cached file and its .http validators
+// must be just as they were, with no .part left behind. Exits with failure if any check fails.
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkProxy>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include "LeapFetcher.h"
+#include "StubServer.h"
+
+#define WATCHDOG 20000 // ms, for a fetch that never finishes
+
+static int failures=0;
+
+static void check(bool ok,const char *what)
+{
+	if (ok) return;
+	fprintf(stderr,"fetchtest:   %s\n",what);
+	failures++;
+}
+
+static bool readFile(const QString &fname,QByteArray &contents)
+{
+	QFile f(fname);
+	if (!f.open(QIODevice::ReadOnly)) return false;
+	contents = f.readAll();
+	return true;
+}
+
+// The cached file and its validators, to check that a failed fetch leaves them alone
+class Snapshot
+{
+	public:
+	
+		Snapshot(const QString &f)
+		{
+			file=f;
+			hasFile = readFile(file,contents);
+			hasValidators = readFile(LeapFetcher::validatorFile(file),validators);
+		}
+		
+		bool unchanged()
+		{
+			Snapshot now(file);
+			return now.hasFile == hasFile && now.contents == contents &&
+				now.hasValidators == hasValidators && now.validators == validators;
+		}
+		
+	private:
+	
+		QString file;
+		QByteArray contents,validators;
+		bool hasFile,hasValidators;
+};
+
+static int fetch(LeapFetcher &fetcher,QNetworkAccessManager &nam,const QString &url,const QString &file)
+{
+	// Returns the Result, or -1 if the fetch didn't start or never finished
+	QEventLoop loop;
+	QObject::connect(&fetcher,SIGNAL(fetched(int)),&loop,SLOT(exit(int)));
+	QTimer::singleShot(WATCHDOG,&loop,SLOT(quit()));
+	fetcher.fetch(&nam,url,file);
+	if (!fetcher.busy()) return -1;
+	int result = loop.exec();
+	return (fetcher.busy() ? -1 : result);
+}
+
+static void report(const char *name,int failures0)
+{
+	fprintf(stdout,"%-12s %s\n",name,(failures == failures0 ? "ok" : "FAILED"));
+	fflush(stdout);
+}
+
+int main(int argc,char *argv[])
+{
+	QCoreApplication app(argc,argv);
+	
+	QByteArray good;
+	if (!readFile(QString(FIXTUREDIR) + "/leap-seconds.list",good)){
+		fprintf(stderr,"fetchtest: can't read the fixture's leap second file\n");
+		return EXIT_FAILURE;
+	}
+	
+	// The same file, with the last digit of the hash changed
+	QByteArray badHash = good;
+	int h = badHash.indexOf("\n#h");
+	int eol = (h < 0 ? -1 : badHash.indexOf('\n',h+1));
+	if (eol < 0) eol = badHash.size();
+	while (h >= 0 && eol > h && !isxdigit((unsigned char) badHash.at(eol-1))) eol--;
+	if (h < 0 || eol <= h+3){
+		fprintf(stderr,"fetchtest: the fixture's leap second file has no #h line\n");
+		return EXIT_FAILURE;
+	}
+	badHash[eol-1] = (badHash.at(eol-1) == '0' ? '1' : '0');
+	
+	QTemporaryDir dir;
+	StubServer server;
+	if (!dir.isValid() || !server.start()){
+		fprintf(stderr,"fetchtest: can't make a temporary directory or start the server\n");
+		return EXIT_FAILURE;
+	}
+	QString file = dir.path() + "/leap-seconds.list";
+	QString part = file + ".part";
+	QString url = server.url();
+	
+	QNetworkAccessManager nam;
+	nam.setProxy(QNetworkProxy::NoProxy); // http_proxy mustn't get between us and the server
+	LeapFetcher fetcher;
+	
+	const QByteArray etag = "\"1467936000\"";
+	const QByteArray lastModified = "Fri, 08 Jul 2016 00:00:00 GMT";
+	int f0;
+	
+	// A fresh download
+	f0=failures;
+	server.setValidators(etag,lastModified);
+	server.serve(StubServer::Normal,good);
+	QByteArray contents,validators;
+	check(fetch(fetcher,nam,url,file) == LeapFetcher::Updated,"the download wasn't reported as an update");
+	check(server.status() == 200,"the server didn't send the file");
+	check(readFile(file,contents) && contents == good,"the cached file isn't what was served");
+	check(readFile(LeapFetcher::validatorFile(file),validators) &&
+		validators == "ETag: " + etag + "\nLast-Modified: " + lastModified + "\n","the validators weren't saved");
+	check(!QFile::exists(part),"the .part file was left behind");
+	report("200",f0);
+	
+	// Asking again, with the saved validators
+	f0=failures;
+	Snapshot cached(file);
+	check(fetch(fetcher,nam,url,file) == LeapFetcher::NotModified,"the request wasn't reported as not modified");
+	check(server.requestHeader("If-None-Match") == etag,"If-None-Match wasn't sent");
+	check(server.requestHeader("If-Modified-Since") == lastModified,"If-Modified-Since wasn't sent");
+	check(server.status() == 304,"the server didn't answer with 304");
+	check(cached.unchanged(),"the cache changed");
+	check(!QFile::exists(part),"the .part file was left behind");
+	report("304",f0);
+	
+	// From here on the server has a newer version, which it fails to deliver
+	server.setValidators("\"1483574400\"","Thu, 05 Jan 2017 00:00:00 GMT");
+	
+	f0=failures;
+	server.serve(StubServer::Truncate,good);
+	check(fetch(fetcher,nam,url,file) == LeapFetcher::Failed,"the truncated download wasn't rejected");
+	check(cached.unchanged(),"the cache changed");
+	check(!QFile::exists(part),"the .part file was left behind");
+	report("truncated",f0);
+	
+	f0=failures;
+	server.serve(StubServer::Normal,badHash);
+	check(fetch(fetcher,nam,url,file) == LeapFetcher::Failed,"the download with a bad hash wasn't rejected");
+	check(server.status() == 200,"the server didn't send the file");
+	check(cached.unchanged(),"the cache changed");
+	check(!QFile::exists(part),"the .part file was left behind");
+	report("badhash",f0);
+	
+	f0=failures;
+	server.serve(StubServer::Flood);
+	check(fetch(fetcher,nam,url,file) == LeapFetcher::Failed,"the oversized download wasn't rejected");
+	check(server.bodySent() < StubServer::FloodSize,"the oversized download wasn't cut off");
+	check(cached.unchanged(),"the cache changed");
+	check(!QFile::exists(part),"the .part file was left behind");
+	report("oversized",f0);
+	fprintf(stdout,"             %lld of %d bytes sent before the cut off\n",server.bodySent(),(int) StubServer::FloodSize);
+	
+	f0=failures;
+	fetcher.setTimeout(1000);
+	server.serve(StubServer::Stall);
+	QElapsedTimer elapsed;
+	elapsed.start();
+	check(fetch(fetcher,nam,url,file) == LeapFetcher::Failed,"the stalled download wasn't abandoned");
+	check(elapsed.elapsed() >= 900,"the stalled download was abandoned before the timeout"); // a coarse timer can be 5% early
+	check(cached.unchanged(),"the cache changed");
+	check(!QFile::exists(part),"the .part file was left behind");
+	report("timeout",f0);
+	
+	if (failures){
+		fprintf(stderr,"fetchtest: %d checks failed\n",failures);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
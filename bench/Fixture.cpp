@@ -0,0 +1,124 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstdio>
+
+#include <QDir>
+#include <QFile>
+#include <QLinearGradient>
+#include <QPainter>
+
+#include "Fixture.h"
+
+Fixture::Fixture(const QString &src,bool keep)
+{
+	dir.setAutoRemove(!keep);
+	ok = dir.isValid() && make(src);
+}
+
+bool Fixture::isValid()
+{
+	return ok;
+}
+
+QString Fixture::path()
+{
+	return dir.path();
+}
+
+void Fixture::setLightLevel(int level)
+{
+	QFile f(dir.path() + "/lightlevel");
+	if (f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		f.write(QByteArray::number(level));
+}
+
+bool Fixture::addConfig(const QString &elem)
+{
+	QFile f(dir.path() + "/rpiclock.xml");
+	if (!f.open(QIODevice::ReadOnly)) return false;
+	QByteArray cfg = f.readAll();
+	f.close();
+	int end = cfg.lastIndexOf("</rpiclock>");
+	if (end < 0) return false;
+	cfg.insert(end," " + elem.toUtf8() + "\n");
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+	return f.write(cfg) == cfg.size();
+}
+
+QImage Fixture::gradient(int w,int h,const QColor &c0,const QColor &c1)
+{
+	// A gradient, so that the luminance and dimming code have something to chew on
+	QImage im(w,h,QImage::Format_RGB32);
+	QPainter p(&im);
+	QLinearGradient g(0,0,w,h);
+	g.setColorAt(0,c0);
+	g.setColorAt(1,c1);
+	p.fillRect(im.rect(),g);
+	p.end();
+	return im;
+}
+
+void Fixture::makeImage(const QString &fname,int w,int h,const QColor &c0,const QColor &c1)
+{
+	gradient(w,h,c0,c1).save(fname);
+}
+
+//
+//
+//
+
+bool Fixture::make(const QString &src)
+{
+	QString d = dir.path();
+	
+	QFile tmpl(src + "/rpiclock.xml");
+	if (!tmpl.open(QIODevice::ReadOnly)){
+		fprintf(stderr,"can't open %s\n",qPrintable(tmpl.fileName()));
+		return false;
+	}
+	QByteArray cfg = tmpl.readAll();
+	cfg.replace("@FIXTURE@",QFile::encodeName(d));
+	QFile out(d + "/rpiclock.xml");
+	if (!out.open(QIODevice::WriteOnly) || out.write(cfg) != cfg.size())
+		return false;
+	out.close();
+	
+	if (!QFile::copy(src + "/leap-seconds.list",d + "/leap-seconds.list"))
+		return false;
+	
+	QDir qd(d);
+	qd.mkdir("images");
+	qd.mkdir("events");
+	// light and dark slides, so that the text colour flips as the slideshow advances
+	makeImage(d + "/images/Nobody__Default__0.png",1920,1080,QColor(10,10,40),QColor(40,40,80));
+	makeImage(d + "/images/Nobody__Light__1.png",1920,1080,QColor(230,230,200),QColor(250,250,250));
+	makeImage(d + "/images/Nobody__Dark__2.png",1920,1080,QColor(0,0,0),QColor(60,20,20));
+	makeImage(d + "/images/Nobody__Mid__3.png",1920,1080,QColor(20,90,20),QColor(200,200,120));
+	makeImage(d + "/events/Nobody__New Year__0.png",1920,1080,QColor(80,1,48),QColor(160,40,100));
+	makeImage(d + "/logo.png",128,128,QColor(255,255,255),QColor(0,120,200));
+	setLightLevel(255);
+	return true;
+}
@@ -0,0 +1,61 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __FIXTURE_H_
+#define __FIXTURE_H_
+
+#include <QColor>
+#include <QImage>
+#include <QString>
+#include <QTemporaryDir>
+
+// A throwaway rpiclock setup for the benchmarks, built in a temporary directory from the
+// templates in bench/fixture: a config file, slideshow and calendar images, a logo, a light level
+// file and a leap second file.
+
+class Fixture
+{
+	public:
+	
+		Fixture(const QString &src,bool keep=false);
+		
+		bool isValid();
+		QString path();
+		
+		void setLightLevel(int);
+		bool addConfig(const QString &); // an element, appended to the config file
+		
+		static QImage gradient(int,int,const QColor &,const QColor &);
+		static void makeImage(const QString &,int,int,const QColor &,const QColor &);
+		
+	private:
+	
+		bool make(const QString &);
+		
+		QTemporaryDir dir;
+		bool ok;
+};
+
+#endif
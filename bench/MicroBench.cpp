@@ -0,0 +1,603 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// microbench - times the hot kernels one at a time
+//
+// Each kernel is run repeatedly for at least the minimum time, and one CSV line is printed per case:
+//   version,kernel,case,iterations,mean_us,min_us,max_us
+// so that results can be collected and compared across versions.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/timex.h>
+
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QTextStream>
+
+#include "ClockSource.h"
+#include "Fixture.h"
+#include "Housekeeper.h"
+#include "LeapFile.h"
+#include "LuminanceTable.h"
+#include "TickScheduler.h"
+#include "TickStats.h"
+#include "TimeDisplay.h"
+#include "TimeScales.h"
+#include "ZoneInfo.h"
+
+QApplication *app; // TimeDisplay expects this
+
+#define LARGELEAPS  10000 // entries in the large leap second file
+#define LARGEEVENTS 2000  // calendar events in the large config file
+#define BLINKDELAY  500   // ms into the second that a blinking separator goes out, as TimeDisplay has it
+
+static volatile double sink; // results go here, so that the kernels can't be optimised away
+
+class MicroBench
+{
+	public:
+	
+		MicroBench(const QString &v,int minMs)
+		{
+			version=v;
+			minTime=(qint64) minMs*1000;
+			clock=NULL;
+			scale=todFormat=hourFormat=dateFormat=0;
+			blink=false;
+		}
+		
+		void header()
+		{
+			fprintf(stdout,"version,kernel,case,iterations,mean_us,min_us,max_us\n");
+			fflush(stdout);
+		}
+		
+		void luminance(const QImage &im)
+		{
+			// Building the table, once per background, then the mean over the band that the time of day occupies
+			LuminanceTable lt;
+			qint64 t0,tmin=-1,tmax=0,sum=0;
+			int n=0;
+			do{
+				t0=TickStats::now();
+				lt.build(im);
+				record(TickStats::now()-t0,tmin,tmax,sum,n);
+			} while (sum < minTime || n < 3);
+			report("luminancetable",sizeName(im),n,sum,tmin,tmax);
+			
+			QRect r(0,im.height()/5,im.width(),im.height()/3);
+			tmin=-1;tmax=0;sum=0;
+			n=0;
+			do{
+				t0=TickStats::now();
+				sink = lt.mean(r);
+				record(TickStats::now()-t0,tmin,tmax,sum,n);
+			} while (sum < minTime || n < 3);
+			report("luminance",sizeName(im),n,sum,tmin,tmax);
+		}
+		
+		void dimBackground(const QImage &im)
+		{
+			qint64 t0,tmin=-1,tmax=0,sum=0;
+			int n=0;
+			do{
+				t0=TickStats::now();
+				sink = Housekeeper::dimmed(im,25).pixel(0,0);
+				record(TickStats::now()-t0,tmin,tmax,sum,n);
+			} while (sum < minTime || n < 3);
+			report("dimbackground",sizeName(im),n,sum,tmin,tmax);
+		}
+		
+		void dimLogo(const QImage &im)
+		{
+			qint64 t0,tmin=-1,tmax=0,sum=0;
+			int n=0;
+			do{
+				t0=TickStats::now();
+				sink = TimeDisplay::dimmedLogo(im,25).pixel(0,0);
+				record(TickStats::now()-t0,tmin,tmax,sum,n);
+			} while (sum < minTime || n < 3);
+			report("dimlogo",sizeName(im),n,sum,tmin,tmax);
+		}
+		
+		void leapFile(const QString &fname,const QString &name)
+		{
+			// As the housekeeper reads it: mapped, parsed and checked against its hash
+			LeapFile lf;
+			qint64 t0,tmin=-1,tmax=0,sum=0;
+			int n=0;
+			do{
+				t0=TickStats::now();
+				sink = lf.read(fname);
+				record(TickStats::now()-t0,tmin,tmax,sum,n);
+			} while (sum < minTime || n < 3);
+			sink = lf.table().size();
+			report("readleapfile",name,n,sum,tmin,tmax);
+		}
+		
+		void leapLookup(const QString &fname)
+		{
+			// The per-tick lookup of the current leap seconds, cached and by searching the table
+			LeapFile lf;
+			lf.read(fname);
+			LeapTable &table = lf.table();
+			const char *cases[] = {"cached","search"};
+			for (int c=0;c<2;c++){
+				unsigned int t=QDateTime(QDate(1986,1,1),QTime(0,0,0),Qt::UTC).toTime_t(); // mid-table, with a leap every day
+				qint64 t0,tmin=-1,tmax=0,sum=0;
+				int n=0;
+				do{
+					t0=TickStats::now();
+					for (int i=0;i<1000;i++,t++) // a tick a second
+						sink = (c == 0 ? table.current(t) : table.dtTAIUTC(t));
+					record(TickStats::now()-t0,tmin,tmax,sum,n);
+				} while (sum < minTime || n < 3);
+				report("leaplookup1000",cases[c],n,sum,tmin,tmax);
+			}
+		}
+		
+		void zoneLookup(const QString &name)
+		{
+			// A world clock zone's offset, per tick, cached until its next transition and by searching
+			ZoneInfo zone;
+			if (!zone.load(name)){
+				fprintf(stderr,"microbench: no zoneinfo for %s, so zonelookup1000 is skipped\n",qPrintable(name));
+				return;
+			}
+			const char *cases[] = {"cached","search"};
+			for (int c=0;c<2;c++){
+				qint64 t=QDateTime(QDate(2016,12,31),QTime(23,30,0),Qt::UTC).toMSecsSinceEpoch();
+				qint64 t0,tmin=-1,tmax=0,sum=0;
+				int n=0;
+				do{
+					t0=TickStats::now();
+					for (int i=0;i<1000;i++,t+=1000) // a tick a second
+						sink = (c == 0 ? zone.at(t).utcOffset : zone.lookup(t/1000).utcOffset);
+					record(TickStats::now()-t0,tmin,tmax,sum,n);
+				} while (sum < minTime || n < 3);
+				report("zonelookup1000",cases[c],n,sum,tmin,tmax);
+			}
+		}
+		
+		void config(TimeDisplay *disp,const QString &fname,const QString &name)
+		{
+			qint64 t0,tmin=-1,tmax=0,sum=0;
+			int n=0;
+			do{
+				t0=TickStats::now();
+				sink = disp->readConfig(fname);
+				record(TickStats::now()-t0,tmin,tmax,sum,n);
+			} while (sum < minTime || n < 3);
+			report("readconfig",name,n,sum,tmin,tmax);
+		}
+		
+		void formatting(TimeDisplay *disp)
+		{
+			// A second at a time, as the display would see it
+			QDateTime start(QDate(2016,12,31),QTime(23,30,0),Qt::UTC);
+			const char *kernels[] = {"formattime","formatdate","showtime","showdate"};
+			for (int k=0;k<4;k++){
+				QDateTime now=start;
+				qint64 t0,tmin=-1,tmax=0,sum=0;
+				int n=0;
+				do{
+					t0=TickStats::now();
+					switch (k){
+						case 0: sink = disp->formatTime(now).size();break;
+						case 1: sink = disp->formatDate(now).size();break;
+						case 2: disp->showTime(now);break;
+						case 3: disp->showDate(now);break;
+					}
+					record(TickStats::now()-t0,tmin,tmax,sum,n);
+					now=now.addSecs(1);
+				} while (sum < minTime || n < 3);
+				report(kernels[k],"local",n,sum,tmin,tmax);
+			}
+		}
+		
+		bool checkFormatting(TimeDisplay *disp)
+		{
+			// The formatter has to give exactly what sprintf() and QDateTime::toString() used to,
+			// for the original time scales, every TOD format and combination of date flags. Stepping across
+			// midnight checks that the cached date line is rebuilt when it should be. The display
+			// converts to local time itself, so local time in the reference is the C library's, in the
+			// fixture's time zone, and both of its daylight saving changes in 2016 are stepped through.
+			// The countdown is left changed; reading the config puts it back.
+			clock = disp->findChild<ClockSource *>();
+			countdown = QDateTime(QDate(2017,1,1),QTime(0,0,0),Qt::UTC);
+			disp->setCountdown(countdown);
+			
+			QDateTime leap(QDate(2016,12,30),QTime(21,0,0,0),Qt::UTC);
+			QDateTime dstEnd(QDate(2016,4,2),QTime(15,0,0,0),Qt::UTC);   // 03:00 AEDT goes back to 02:00 AEST at 16:00
+			QDateTime dstStart(QDate(2016,10,1),QTime(15,0,0,0),Qt::UTC); // 02:00 AEST goes forward to 03:00 AEDT at 16:00
+			int bad=0;
+			checkTimes(disp,leap,4000,bad);
+			checkTimes(disp,dstEnd,200,bad);
+			checkTimes(disp,dstStart,200,bad);
+			checkDates(disp,leap,1500,bad);
+			checkDates(disp,dstEnd.addSecs(-5*3600),400,bad); // through local midnight and the change
+			checkDates(disp,dstStart.addSecs(-5*3600),400,bad);
+			checkScales(disp,bad);
+			return bad == 0;
+		}
+		
+	private:
+	
+		void checkTimes(TimeDisplay *disp,QDateTime now,int steps,int &bad)
+		{
+			for (int i=0;i<steps && bad < 10;i++,now=now.addMSecs(37007)){ // wanders through every second and ms
+				QDateTime local=now.toLocalTime();
+				for (scale=TimeDisplay::Local;scale<=TimeDisplay::Countdown;scale++)
+					for (todFormat=TimeDisplay::hhmm;todFormat<=TimeDisplay::hhmmss_ms;todFormat++)
+						for (hourFormat=TimeDisplay::TwelveHour;hourFormat<=TimeDisplay::TwentyFourHour;hourFormat++)
+							for (int b=0;b<2;b++){
+								blink=b;
+								QString s=disp->formatTime(now,scale,todFormat,hourFormat,blink);
+								QString ref=referenceTime(disp,local);
+								if (s != ref && bad++ < 10)
+									fprintf(stderr,"microbench: time %s differs: '%s' should be '%s'\n",
+										qPrintable(now.toString(Qt::ISODate)),qPrintable(s),qPrintable(ref));
+							}
+			}
+		}
+		
+		void checkDates(TimeDisplay *disp,const QDateTime &start,int steps,int &bad)
+		{
+			// A format at a time, so that the cache is used
+			for (scale=TimeDisplay::Local;scale<=TimeDisplay::Countdown;scale++){
+				for (dateFormat=0;dateFormat<32 && bad < 10;dateFormat++){
+					QDateTime now=start;
+					for (int i=0;i<steps;i++,now=now.addMSecs(197003)){
+						QDateTime local=now.toLocalTime();
+						QString s=disp->formatDate(now,scale,dateFormat);
+						QString ref=referenceDate(disp,local);
+						if (s != ref && bad++ < 10)
+							fprintf(stderr,"microbench: date %s differs: '%s' should be '%s'\n",
+								qPrintable(now.toString(Qt::ISODate)),qPrintable(s),qPrintable(ref));
+					}
+				}
+			}
+		}
+		
+		void checkScales(TimeDisplay *disp,int &bad)
+		{
+			// The scales added since have no old formatting to compare with, so they're checked against
+			// known readings, just after the 2016 leap second, when TAI-UTC became 37 s
+			if (disp->taiUTC() != 37){
+				fprintf(stderr,"microbench: TAI-UTC is %d s rather than 37 s, so the other time scales can't be checked\n",
+					disp->taiUTC());
+				bad++;
+				return;
+			}
+			QDateTime newYear(QDate(2017,1,1),QTime(0,0,0),Qt::UTC);
+			struct {int secs,scale,todFormat; const char *ref;} times[] = {
+				{0,TimeDisplay::TAI,TimeDisplay::hhmmss,"00:00:37"},
+				{0,TimeDisplay::TT,TimeDisplay::hhmmss_ms,"00:01:09.184"},
+				{0,TimeDisplay::Galileo,TimeDisplay::hhmmss,"18"}, // seconds into week 906
+				{0,TimeDisplay::BeiDou,TimeDisplay::hhmmss,"4"},   // and week 574
+				{0,TimeDisplay::GLONASS,TimeDisplay::hhmmss,"03:00:00"},
+				{0,TimeDisplay::JulianDate,TimeDisplay::hhmmss,"2457754.50000"},
+				{0,TimeDisplay::ModifiedJulianDate,TimeDisplay::hhmmss,"57754.00000"},
+				{43200,TimeDisplay::JulianDate,TimeDisplay::hhmmss,"2457755.00000"},
+				{43200,TimeDisplay::ModifiedJulianDate,TimeDisplay::hhmmss,"57754.50000"}
+			};
+			struct {int secs,scale,dateFormat; const char *ref;} dates[] = {
+				{0,TimeDisplay::TAI,TimeDisplay::MJD|TimeDisplay::DOY,"MJD 57754 DOY 1"},
+				{0,TimeDisplay::Galileo,TimeDisplay::GPSDayWeek,"Wn 906 Dn 0"},
+				{0,TimeDisplay::BeiDou,TimeDisplay::GPSDayWeek,"Wn 574 Dn 0"},
+				{0,TimeDisplay::GLONASS,TimeDisplay::FourYearDay,"N4 6 NT 367"}, // 2016 was a leap year
+				{0,TimeDisplay::GLONASS,TimeDisplay::ISOdate,"2017-01-01"},
+				{-7200,TimeDisplay::GLONASS,TimeDisplay::ISOdate,"2017-01-01"},  // 01:00 in Moscow
+				{-14400,TimeDisplay::GLONASS,TimeDisplay::FourYearDay,"N4 6 NT 366"},
+				{0,TimeDisplay::ModifiedJulianDate,TimeDisplay::ISOdate|TimeDisplay::DOY,"2017-01-01  DOY 1"}
+			};
+			for (unsigned int i=0;i<sizeof(times)/sizeof(times[0]);i++){
+				QDateTime now=newYear.addSecs(times[i].secs);
+				QString s=disp->formatTime(now,times[i].scale,times[i].todFormat,TimeDisplay::TwentyFourHour,false);
+				if (s != times[i].ref && bad++ < 10)
+					fprintf(stderr,"microbench: %s at %s is '%s', and should be '%s'\n",TimeScales::at(times[i].scale).name,
+						qPrintable(now.toString(Qt::ISODate)),qPrintable(s),times[i].ref);
+			}
+			for (unsigned int i=0;i<sizeof(dates)/sizeof(dates[0]);i++){
+				QDateTime now=newYear.addSecs(dates[i].secs);
+				QString s=disp->formatDate(now,dates[i].scale,dates[i].dateFormat);
+				if (s != dates[i].ref && bad++ < 10)
+					fprintf(stderr,"microbench: %s date at %s is '%s', and should be '%s'\n",TimeScales::at(dates[i].scale).name,
+						qPrintable(now.toString(Qt::ISODate)),qPrintable(s),dates[i].ref);
+			}
+		}
+		
+		int fractionDigits()
+		{
+			if ((scale != TimeDisplay::Local && scale != TimeDisplay::UTC) || todFormat < TimeDisplay::hhmmss_t)
+				return 0;
+			return todFormat - TimeDisplay::hhmmss;
+		}
+		
+		// The formatting as it was before TimeFormatter, given local time and the settings being checked
+		QString referenceTime(TimeDisplay *disp,QDateTime &now)
+		{
+			char sep=':';
+			if (blink && now.time().msec() >= BLINKDELAY) sep=' ';
+			QDateTime UTCnow = now.toUTC();
+			int leapCorrection=0;
+			if (UTCnow.time().hour() == 23 && UTCnow.time().minute() == 59 && UTCnow.time().second() ==59 &&
+				clock && clock->leapState() == TIME_OOP)
+				leapCorrection = 1;
+			QString s;
+			QDateTime &t = (scale == TimeDisplay::UTC ? UTCnow : now);
+			switch (scale){
+				case TimeDisplay::Local:
+				case TimeDisplay::UTC:
+					if (todFormat >= TimeDisplay::hhmmss){
+						if (scale == TimeDisplay::UTC || hourFormat == TimeDisplay::TwentyFourHour)
+							s.sprintf("%02d%c%02d%c%02d",t.time().hour(),sep,t.time().minute(),sep,t.time().second()+leapCorrection);
+						else{
+							int hr=t.time().hour();
+							if (t.time().hour() > 12)  hr=t.time().hour()-12;
+							if (t.time().hour() == 0 ) hr=t.time().hour()+12;
+							s.sprintf("%d%c%02d%c%02d",hr,sep,t.time().minute(),sep,t.time().second()+leapCorrection);
+						}
+					}
+					else
+						s.sprintf("%02d%c%02d",t.time().hour(),sep,t.time().minute());
+					if (fractionDigits() > 0){
+						int msec=t.time().msec();
+						for (int i=fractionDigits();i<3;i++) msec /= 10;
+						s.append('.');
+						s.append(QString::number(msec).rightJustified(fractionDigits(),'0'));
+					}
+					break;
+				case TimeDisplay::Unix:
+					s.sprintf("%i",(int) now.toTime_t());
+					break;
+				case TimeDisplay::GPS:
+				{
+					int nsecs = now.toTime_t()-Scale<TimeDisplay::GPS>::epoch()+disp->taiUTC()-DELTATAIGPS+leapCorrection;
+					int nweeks = int(nsecs/86400/7);
+					s.sprintf("%i",nsecs - nweeks*86400*7);
+					break;
+				}
+				case TimeDisplay::Countdown:
+				{
+					int dt = now.toTime_t() - countdown.toTime_t();
+					if (dt <0) dt *= -1;
+					s.sprintf("%i s", dt);
+					break;
+				}
+			}
+			return s;
+		}
+		
+		QString referenceDate(TimeDisplay *disp,QDateTime &now)
+		{
+			QString s(""),stmp;
+			QString sep="";
+			QDateTime tmpdt = (scale != TimeDisplay::Countdown ? now : countdown);
+			if (dateFormat & TimeDisplay::ISOdate){
+				s.append(sep);
+				s.append(tmpdt.toString("yyyy-MM-dd"));
+				sep="  ";
+			}
+			if (dateFormat & TimeDisplay::PrettyDate){
+				s.append(sep);
+				s.append(tmpdt.toString("dd MMM yyyy"));
+				s.remove('.');
+				sep=" ";
+			}
+			if (dateFormat & TimeDisplay::MJD){
+				s.append(sep);
+				int tt = tmpdt.toTime_t();
+				stmp.sprintf("MJD %d",tt/86400 + 40587);
+				s.append(stmp);
+				sep=" ";
+			}
+			if (dateFormat & TimeDisplay::GPSDayWeek){
+				s.append(sep);
+				int nsecs = tmpdt.toTime_t()-Scale<TimeDisplay::GPS>::epoch()+disp->taiUTC()-DELTATAIGPS;
+				int wn = int(nsecs/86400/7);
+				int dn  = int((nsecs- wn*86400*7)/86400);
+				stmp.sprintf("Wn %i Dn %i",wn,dn);
+				s.append(stmp);
+				sep=" ";
+			}
+			if (dateFormat & TimeDisplay::DOY){
+				s.append(sep);
+				int doy;
+				if (scale == TimeDisplay::UTC || scale == TimeDisplay::Unix)
+					doy=tmpdt.toUTC().date().dayOfYear();
+				else
+					doy=tmpdt.date().dayOfYear();
+				stmp.sprintf("DOY %d",doy);
+				s.append(stmp);
+			}
+			return s;
+		}
+		
+		QString sizeName(const QImage &im)
+		{
+			return QString("%1x%2").arg(im.width()).arg(im.height());
+		}
+		
+		void record(qint64 dt,qint64 &tmin,qint64 &tmax,qint64 &sum,int &n)
+		{
+			if (tmin < 0 || dt < tmin) tmin=dt;
+			if (dt > tmax) tmax=dt;
+			sum += dt;
+			n++;
+		}
+		
+		void report(const char *kernel,const QString &name,int n,qint64 sum,qint64 tmin,qint64 tmax)
+		{
+			fprintf(stdout,"%s,%s,%s,%d,%.3f,%lld,%lld\n",qPrintable(version),kernel,qPrintable(name),n,
+				(double) sum/n,tmin,tmax);
+			fflush(stdout);
+		}
+		
+		QString version;
+		qint64 minTime; // us
+		
+		// What's being checked
+		ClockSource *clock;
+		QDateTime countdown;
+		int scale,todFormat,hourFormat,dateFormat;
+		bool blink;
+};
+
+static bool makeLargeLeapFile(const QString &fname)
+{
+	// Same format as leap-seconds.list, with a leap second every day
+	QFile f(fname);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+	QTextStream out(&f);
+	unsigned int t=2272060800U; // 1 Jan 1972
+	QCryptographicHash sha1(QCryptographicHash::Sha1); // over the data, as the #h line is
+	sha1.addData("3676924800");
+	sha1.addData("4000000000");
+	out << "#\tsynthetic leap second file for microbench\n";
+	out << "#$\t3676924800\n";
+	out << "#@\t4000000000\n";
+	for (int i=0;i<LARGELEAPS;i++,t += 86400){
+		out << t << "\t" << (10+i) << "\t# " << i << "\n";
+		sha1.addData(QByteArray::number(t) + QByteArray::number(10+i));
+	}
+	QByteArray h = sha1.result().toHex();
+	out << "#h\t" << h.mid(0,8) << " " << h.mid(8,8) << " " << h.mid(16,8) << " " << h.mid(24,8) << " " << h.mid(32,8) << "\n";
+	return true;
+}
+
+static bool makeLargeConfig(const QString &src,const QString &fname)
+{
+	// The fixture config with lots of calendar events
+	QFile in(src);
+	if (!in.open(QIODevice::ReadOnly)) return false;
+	QByteArray cfg = in.readAll();
+	QByteArray events;
+	for (int i=0;i<LARGEEVENTS;i++){
+		int m = 1 + (i % 12);
+		int d = 1 + (i % 28);
+		events += QString("  <event>\n   <startday>%1</startday>\n   <startmonth>%2</startmonth>\n"
+			"   <stopday>%1</stopday>\n   <stopmonth>%2</stopmonth>\n   <image>/nonexistent/%3.png</image>\n"
+			"   <description>Event %3</description>\n  </event>\n").arg(d).arg(m).arg(i).toLatin1();
+	}
+	int pos = cfg.indexOf("</background>");
+	if (pos < 0) return false;
+	cfg.insert(pos,events);
+	QFile out(fname);
+	if (!out.open(QIODevice::WriteOnly)) return false;
+	return out.write(cfg) == cfg.size();
+}
+
+static void usage()
+{
+	fprintf(stdout,"Usage: microbench [options]\n\n");
+	fprintf(stdout,"--min <ms>        minimum time to run each case for (default 500)\n");
+	fprintf(stdout,"--tag <version>   version to label the results with (default %s)\n",BENCH_VERSION);
+	fprintf(stdout,"--fixture <dir>   fixture source directory (default %s)\n",FIXTUREDIR);
+}
+
+int main(int argc,char *argv[])
+{
+	if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+		qputenv("QT_QPA_PLATFORM","offscreen");
+	
+	app = new QApplication(argc,argv);
+	
+	int minMs=500;
+	QString tag(BENCH_VERSION);
+	QString fixtureSrc(FIXTUREDIR);
+	
+	QStringList args = app->arguments();
+	for (int i=1;i<args.size();i++){
+		if (args.at(i) == "--min" && i+1 < args.size())
+			minMs=args.at(++i).toInt();
+		else if (args.at(i) == "--tag" && i+1 < args.size())
+			tag=args.at(++i);
+		else if (args.at(i) == "--fixture" && i+1 < args.size())
+			fixtureSrc=args.at(++i);
+		else{
+			usage();
+			return (args.at(i) == "--help" ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	
+	Fixture fixture(fixtureSrc);
+	if (!fixture.isValid() || 
+		!makeLargeLeapFile(fixture.path() + "/leap-seconds.large") ||
+		!makeLargeConfig(fixture.path() + "/rpiclock.xml",fixture.path() + "/rpiclock.large.xml")){
+		fprintf(stderr,"microbench: failed to make the fixture\n");
+		return EXIT_FAILURE;
+	}
+	QDir::setCurrent(fixture.path()); // so that ./rpiclock.xml is found first
+	
+	MicroBench mb(tag,minMs);
+	mb.header();
+	
+	QImage hd = Fixture::gradient(1920,1080,QColor(20,90,20),QColor(200,200,120));
+	QImage uhd = Fixture::gradient(3840,2160,QColor(20,90,20),QColor(200,200,120));
+	mb.luminance(hd);
+	mb.luminance(uhd);
+	mb.dimBackground(hd);
+	mb.dimBackground(uhd);
+	
+	QImage logo = QImage(fixture.path() + "/logo.png").convertToFormat(QImage::Format_ARGB32);
+	mb.dimLogo(logo);
+	mb.dimLogo(logo.scaled(512,512));
+	
+	mb.leapFile(fixture.path() + "/leap-seconds.list","fixture");
+	mb.leapFile(fixture.path() + "/leap-seconds.large","large");
+	mb.leapLookup(fixture.path() + "/leap-seconds.large");
+	mb.zoneLookup("Europe/London");
+	
+	QStringList tdArgs;
+	tdArgs << "microbench" << "--nocheck" << "--nofullscreen";
+	TimeDisplay *disp = new TimeDisplay(tdArgs);
+	TickScheduler *sched = disp->findChild<TickScheduler *>();
+	if (sched) sched->stop(); // nothing should run behind our back
+	disp->show();
+	app->processEvents();
+	
+	mb.config(disp,fixture.path() + "/rpiclock.xml","fixture");
+	mb.config(disp,fixture.path() + "/rpiclock.large.xml","large");
+	disp->readConfig(fixture.path() + "/rpiclock.xml"); // back to normal
+	
+	bool formatOK = mb.checkFormatting(disp);
+	disp->readConfig(fixture.path() + "/rpiclock.xml"); // for the countdown
+	if (!formatOK){
+		fprintf(stderr,"microbench: formatting doesn't match the reference\n");
+		delete disp;
+		return EXIT_FAILURE;
+	}
+	mb.formatting(disp);
+	
+	delete disp;
+	return EXIT_SUCCESS;
+}
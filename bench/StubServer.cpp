@@ -0,0 +1,176 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <QHostAddress>
+#include <QList>
+
+#include "StubServer.h"
+
+StubServer::StubServer(QObject *parent):QTcpServer(parent)
+{
+	mode=Normal;
+	lastStatus=0;
+	sent=0;
+	connect(this,SIGNAL(newConnection()),this,SLOT(accept()));
+}
+
+bool StubServer::start()
+{
+	return listen(QHostAddress::LocalHost,0); // any free port
+}
+
+QString StubServer::url()
+{
+	return QString("http://127.0.0.1:%1/leap-seconds.list").arg(serverPort());
+}
+
+void StubServer::serve(int m,const QByteArray &b)
+{
+	mode=m;
+	body=b;
+}
+
+void StubServer::setValidators(const QByteArray &e,const QByteArray &lm)
+{
+	etag=e;
+	lastModified=lm;
+}
+
+QByteArray StubServer::requestHeader(const QByteArray &name)
+{
+	QList<QByteArray> lines = req.split('\n');
+	for (int i=1;i<lines.size();i++){ // skip the request line
+		int colon = lines.at(i).indexOf(':');
+		if (colon > 0 && lines.at(i).left(colon).trimmed().toLower() == name.toLower())
+			return lines.at(i).mid(colon+1).trimmed();
+	}
+	return QByteArray();
+}
+
+int StubServer::status()
+{
+	return lastStatus;
+}
+
+qint64 StubServer::bodySent()
+{
+	return sent;
+}
+
+//
+// Private slots
+//
+
+void StubServer::accept()
+{
+	while (hasPendingConnections()){
+		QTcpSocket *s = nextPendingConnection();
+		if (client){ // the previous one is done with
+			client->abort();
+			client->deleteLater();
+		}
+		client=s;
+		req.clear();
+		lastStatus=0;
+		sent=0;
+		connect(s,SIGNAL(readyRead()),this,SLOT(readRequest()));
+		connect(s,SIGNAL(bytesWritten(qint64)),this,SLOT(writeMore()));
+	}
+}
+
+void StubServer::readRequest()
+{
+	QTcpSocket *s = qobject_cast<QTcpSocket *>(sender());
+	if (!s || s != client || lastStatus) return; // one request per connection
+	req += s->readAll();
+	if (req.contains("\r\n\r\n"))
+		respond();
+}
+
+void StubServer::writeMore()
+{
+	// Keep a little queued, rather than buffering the lot, so that how much the client took can be seen
+	if (!client || mode != Flood || client->state() != QAbstractSocket::ConnectedState) return;
+	static const QByteArray chunk = QByteArray("# padding to make the file too big\n").repeated(2048);
+	while (sent < FloodSize && client->bytesToWrite() < chunk.size()){
+		int n = (int) qMin((qint64) chunk.size(),FloodSize-sent);
+		client->write(chunk.constData(),n);
+		sent += n;
+	}
+	if (sent == FloodSize)
+		client->disconnectFromHost();
+}
+
+//
+//
+//
+
+void StubServer::respond()
+{
+	switch (mode){
+		case Normal:
+		{
+			QByteArray inm = requestHeader("If-None-Match");
+			QByteArray ims = requestHeader("If-Modified-Since");
+			if ((!etag.isEmpty() && inm == etag) || (!lastModified.isEmpty() && ims == lastModified)){
+				writeHeader(304,-1);
+			}
+			else{
+				writeHeader(200,body.size());
+				client->write(body);
+				sent=body.size();
+			}
+			client->disconnectFromHost(); // after what's queued has gone
+			break;
+		}
+		case Truncate:
+			writeHeader(200,body.size()); // promises all of it
+			sent=body.size()/2;
+			client->write(body.left(sent));
+			client->disconnectFromHost();
+			break;
+		case Flood:
+			writeHeader(200,FloodSize);
+			writeMore();
+			break;
+		case Stall:
+			break;
+	}
+}
+
+void StubServer::writeHeader(int st,qint64 len)
+{
+	lastStatus=st;
+	QByteArray h = "HTTP/1.1 " + QByteArray::number(st) + (st == 304 ? " Not Modified" : " OK") + "\r\n";
+	h += "Content-Type: text/plain\r\n";
+	if (!etag.isEmpty())
+		h += "ETag: " + etag + "\r\n";
+	if (!lastModified.isEmpty())
+		h += "Last-Modified: " + lastModified + "\r\n";
+	if (len >= 0)
+		h += "Content-Length: " + QByteArray::number(len) + "\r\n";
+	h += "Connection: close\r\n\r\n";
+	client->write(h);
+}
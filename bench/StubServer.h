@@ -0,0 +1,77 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef __STUB_SERVER_H_
+#define __STUB_SERVER_H_
+
+#include <QByteArray>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+// A one-connection-at-a-time HTTP/1.1 server on the loopback interface, for testing LeapFetcher.
+// It serves one body, honouring If-None-Match and If-Modified-Since against its own validators,
+// or misbehaves in one of a few ways: cutting the body short, sending far more than was asked for,
+// or never answering at all.
+
+class StubServer : public QTcpServer
+{
+	Q_OBJECT
+	
+	public:
+	
+		enum Mode {Normal,Truncate,Flood,Stall};
+		enum {FloodSize=33554432}; // bytes
+		
+		StubServer(QObject *parent=NULL);
+		
+		bool start();
+		QString url();
+		
+		void serve(int,const QByteArray &body=QByteArray()); // a Mode, for the following requests
+		void setValidators(const QByteArray &,const QByteArray &); // ETag, Last-Modified
+		
+		QByteArray requestHeader(const QByteArray &); // of the last request
+		int status(); // of the last response
+		qint64 bodySent(); // bytes of the last body handed to the socket
+		
+	private slots:
+	
+		void accept();
+		void readRequest();
+		void writeMore();
+		
+	private:
+	
+		void respond();
+		void writeHeader(int,qint64);
+		
+		QPointer<QTcpSocket> client;
+		QByteArray req,body,etag,lastModified;
+		int mode,lastStatus;
+		qint64 sent;
+};
+
+#endif
@@ -0,0 +1,272 @@
+//
+// rpiclock - a time display program for the Raspberry Pi/Linux
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2014  Michael J. Wouters
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// tickbench - measures the per-tick cost of TimeDisplay without a monitor
+//
+// TimeDisplay is built on the offscreen platform from a fixture config (slideshow, calendar event,
+// dimming, leap file) and driven through simulated seconds as fast as it will go. The tick scheduler is
+// stopped, so each second is delivered by calling updateTime() directly, followed by one pass of the
+// event loop, which paints the frame and picks up results from the housekeeping thread.
+// For each phase, wall time, CPU time on the GUI thread and heap allocations are reported.
+
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <QApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QVector>
+
+#include "ClockSource.h"
+#include "Fixture.h"
+#include "TickScheduler.h"
+#include "TickStats.h"
+#include "TimeDisplay.h"
+
+QApplication *app; // TimeDisplay expects this
+
+//
+// Allocation counting
+//
+
+static thread_local qint64 nAllocs=0; // per thread, so that the housekeeper doesn't pollute the counts
+
+// Counted at malloc() rather than operator new, since Qt's string, container, image and region storage
+// calls malloc() and realloc() directly. Defining them here interposes them for Qt too; the real ones
+// are glibc's __libc_ entry points, which unlike dlsym(RTLD_NEXT) don't allocate themselves.
+
+extern "C" {
+
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t,size_t);
+void *__libc_realloc(void *,size_t);
+
+void *malloc(size_t sz)
+{
+	nAllocs++;
+	return __libc_malloc(sz);
+}
+
+void *calloc(size_t n,size_t sz)
+{
+	nAllocs++;
+	return __libc_calloc(n,sz);
+}
+
+void *realloc(void *p,size_t sz)
+{
+	if (sz) nAllocs++; // growing a QString or QVector counts, as it would have been a new block
+	return __libc_realloc(p,sz);
+}
+
+}
+
+static qint64 cpuTime(clockid_t clk)
+{
+	// in us
+	struct timespec ts;
+	clock_gettime(clk,&ts);
+	return (qint64) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+//
+// Per-phase measurements
+//
+
+class Phase
+{
+	public:
+	
+		Phase(const char *n){name=n;cpu=allocs=0;}
+		
+		void begin()
+		{
+			a0=nAllocs;
+			c0=cpuTime(CLOCK_THREAD_CPUTIME_ID);
+			w0=TickStats::now();
+		}
+		
+		void end()
+		{
+			wall.append(TickStats::now()-w0);
+			cpu += cpuTime(CLOCK_THREAD_CPUTIME_ID)-c0;
+			allocs += nAllocs-a0;
+		}
+		
+		void report()
+		{
+			int n = wall.size();
+			if (n==0) return;
+			std::sort(wall.begin(),wall.end());
+			qint64 sum=0;
+			for (int i=0;i<n;i++) sum += wall.at(i);
+			fprintf(stdout,"%-12s %8d %10.1f %10lld %10lld %10lld %10.1f %10.1f\n",name,n,
+				(double) sum/n,wall.at(n/2),wall.at((int)(0.99*(n-1))),wall.at(n-1),(double) cpu/n,(double) allocs/n);
+		}
+		
+		const char *name;
+		QVector<qint64> wall; // us
+		qint64 cpu; // us
+		qint64 allocs;
+		
+	private:
+	
+		qint64 w0,c0,a0;
+};
+
+static void usage()
+{
+	fprintf(stdout,"Usage: tickbench [options]\n\n");
+	fprintf(stdout,"-n <seconds>      number of simulated seconds (default 3600)\n");
+	fprintf(stdout,"--start <iso>     UTC start time (default 2016-12-31T23:30:00, spanning a leap second)\n");
+	fprintf(stdout,"--dim <seconds>   toggle the light level this often (default 600, 0 to disable)\n");
+	fprintf(stdout,"--fixture <dir>   fixture source directory (default %s)\n",FIXTUREDIR);
+	fprintf(stdout,"--panel <scales>  show a panel of these time scales too, eg utc,gps,tai,unix\n");
+	fprintf(stdout,"--keep            don't delete the generated fixture\n");
+}
+
+int main(int argc,char *argv[])
+{
+	if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+		qputenv("QT_QPA_PLATFORM","offscreen");
+	
+	app = new QApplication(argc,argv);
+	
+	int nSecs=3600;
+	int dimPeriod=600;
+	bool keep=false;
+	QString panel;
+	QString fixtureSrc(FIXTUREDIR);
+	QDateTime start(QDate(2016,12,31),QTime(23,30,0),Qt::UTC);
+	
+	QStringList args = app->arguments();
+	for (int i=1;i<args.size();i++){
+		if (args.at(i) == "-n" && i+1 < args.size())
+			nSecs=args.at(++i).toInt();
+		else if (args.at(i) == "--start" && i+1 < args.size()){
+			start=QDateTime::fromString(args.at(++i),Qt::ISODate);
+			start.setTimeSpec(Qt::UTC);
+		}
+		else if (args.at(i) == "--dim" && i+1 < args.size())
+			dimPeriod=args.at(++i).toInt();
+		else if (args.at(i) == "--fixture" && i+1 < args.size())
+			fixtureSrc=args.at(++i);
+		else if (args.at(i) == "--panel" && i+1 < args.size())
+			panel=args.at(++i);
+		else if (args.at(i) == "--keep")
+			keep=true;
+		else{
+			usage();
+			return (args.at(i) == "--help" ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	if (nSecs <= 0 || !start.isValid()){
+		usage();
+		return EXIT_FAILURE;
+	}
+	
+	// The formatting that TimeFormatter replaced must register, or the counts below mean nothing.
+	// Qt 5.15's toString() alone calls malloc() 7 times
+	qint64 a0 = nAllocs;
+	QString baseline = start.toString("hh:mm:ss") + QString::number(start.date().dayOfYear());
+	qint64 baselineAllocs = nAllocs-a0;
+	if (baselineAllocs < 3){
+		fprintf(stderr,"tickbench: allocation counting isn't working (%lld for %s)\n",baselineAllocs,qPrintable(baseline));
+		return EXIT_FAILURE;
+	}
+	
+	Fixture fixture(fixtureSrc,keep);
+	if (!fixture.isValid()){
+		fprintf(stderr,"tickbench: failed to make the fixture\n");
+		return EXIT_FAILURE;
+	}
+	if (!panel.isEmpty() && !fixture.addConfig("<panel>" + panel + "</panel>")){
+		fprintf(stderr,"tickbench: failed to add the panel to the config\n");
+		return EXIT_FAILURE;
+	}
+	if (keep)
+		fprintf(stdout,"fixture in %s\n",qPrintable(fixture.path()));
+	QDir::setCurrent(fixture.path()); // so that ./rpiclock.xml is found first
+	
+	QStringList tdArgs;
+	tdArgs << "tickbench" << "--nocheck" << "--nofullscreen" << "--simulate" << start.toString(Qt::ISODate);
+	TimeDisplay *disp = new TimeDisplay(tdArgs);
+	disp->show();
+	
+	// We deliver the ticks, and keep the simulated clock in step with them for everything else that reads it
+	TickScheduler *sched = disp->findChild<TickScheduler *>();
+	if (sched) sched->stop();
+	SimulatedClock *clock = disp->findChild<SimulatedClock *>();
+	TickStats *stats = disp->findChild<TickStats *>();
+	
+	// Let the housekeeper load the first background before timing anything
+	qint64 t = start.toMSecsSinceEpoch();
+	for (int i=0;i<10;i++){
+		QMetaObject::invokeMethod(disp,"updateTime",Qt::DirectConnection,Q_ARG(qint64,t));
+		app->processEvents();
+	}
+	if (stats) stats->reset();
+	
+	Phase update("updateTime"),events("events"),tick("tick");
+	qint64 cpu0  = cpuTime(CLOCK_PROCESS_CPUTIME_ID);
+	qint64 wall0 = TickStats::now();
+	
+	for (int s=0;s<nSecs;s++,t += 1000){
+		if (dimPeriod > 0 && s > 0 && (s % dimPeriod) == 0)
+			fixture.setLightLevel(((s/dimPeriod) % 2) ? 0 : 255);
+		
+		if (clock) clock->stepTo(t);
+		
+		tick.begin();
+		update.begin();
+		QMetaObject::invokeMethod(disp,"updateTime",Qt::DirectConnection,Q_ARG(qint64,t));
+		update.end();
+		events.begin();
+		app->processEvents();
+		events.end();
+		tick.end();
+	}
+	
+	qint64 wall = TickStats::now()-wall0;
+	qint64 cpu  = cpuTime(CLOCK_PROCESS_CPUTIME_ID)-cpu0;
+	
+	fprintf(stdout,"%d simulated seconds from %s UTC\n",nSecs,qPrintable(start.toString(Qt::ISODate)));
+	fprintf(stdout,"%lld allocations for the old formatting of one tick, as a check on the counting\n\n",baselineAllocs);
+	fprintf(stdout,"%-12s %8s %10s %10s %10s %10s %10s %10s\n","phase","calls","mean(us)","p50(us)","p99(us)","max(us)",
+		"cpu(us)","allocs");
+	update.report();
+	events.report();
+	tick.report();
+	fprintf(stdout,"\ntotal wall %.1f ms, process CPU %.1f ms (includes the housekeeping thread)\n",wall/1000.0,cpu/1000.0);
+	fflush(stdout);
+	
+	if (stats) stats->dump(); // the finer breakdown, on stderr
+	
+	delete disp;
+	return EXIT_SUCCESS;
+}
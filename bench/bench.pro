@@ -0,0 +1,3 @@
+# All of the benchmarks, and the fetch test: qmake bench.pro && make
+TEMPLATE      = subdirs
+SUBDIRS       = tickbench.pro microbench.pro fetchtest.pro
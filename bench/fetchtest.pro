@@ -0,0 +1,21 @@
+# Checks LeapFetcher against a stub HTTP server on the loopback interface
+# Build with qmake fetchtest.pro && make, then run ./fetchtest
+
+TEMPLATE      = app
+TARGET        = fetchtest
+INCLUDEPATH  += ..
+VPATH        += ..
+OBJECTS_DIR   = .obj/fetchtest # the targets share a directory
+MOC_DIR       = .moc/fetchtest
+
+HEADERS       = StubServer.h LeapFetcher.h LeapFile.h LeapTable.h
+SOURCES       = FetchTest.cpp \
+								StubServer.cpp \
+								LeapFetcher.cpp \
+								LeapFile.cpp \
+								LeapTable.cpp
+QT            = core network
+
+CONFIG      += console c++11
+DEFINES      += QT_NO_DEBUG_OUTPUT
+DEFINES      += FIXTUREDIR=\\\"$$PWD/fixture\\\"
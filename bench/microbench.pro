@@ -0,0 +1,40 @@
+# Microbenchmarks for the pixel and parsing kernels, with CSV output
+# Build with qmake microbench.pro && make, then run ./microbench --help
+# Needs Qt5 for the offscreen platform plugin
+
+TEMPLATE      = app
+TARGET        = microbench
+INCLUDEPATH  += ..
+VPATH        += ..
+OBJECTS_DIR   = .obj/microbench # the targets share a directory
+MOC_DIR       = .moc/microbench
+
+HEADERS       = Fixture.h TimeDisplay.h ClockCanvas.h ClockSource.h FramePacer.h GlyphAtlas.h Housekeeper.h LeapFetcher.h LeapFile.h LeapMonitor.h LeapTable.h LuminanceTable.h PowerManager.h TextLayer.h Theme.h TickScheduler.h TickStats.h TimeFormatter.h TimeScales.h ZoneInfo.h
+SOURCES       = MicroBench.cpp \
+								Fixture.cpp \
+								TimeDisplay.cpp \
+								ClockCanvas.cpp \
+								ClockSource.cpp \
+								FramePacer.cpp \
+								GlyphAtlas.cpp \
+								Housekeeper.cpp \
+								LeapFetcher.cpp \
+								LeapFile.cpp \
+								LeapMonitor.cpp \
+								LeapTable.cpp \
+								LuminanceTable.cpp \
+								PowerManager.cpp \
+								TextLayer.cpp \
+								Theme.cpp \
+								TickScheduler.cpp \
+								TickStats.cpp \
+								TimeFormatter.cpp \
+								TimeScales.cpp \
+								ZoneInfo.cpp
+QT           += core gui network xml
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG      += release c++11
+DEFINES      += QT_NO_DEBUG_OUTPUT # qDebug() chatter would swamp the timings
+DEFINES      += FIXTUREDIR=\\\"$$PWD/fixture\\\"
+DEFINES      += BENCH_VERSION=\\\"$$system(git -C $$PWD describe --always --dirty 2>/dev/null || echo unknown)\\\"
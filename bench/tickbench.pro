@@ -0,0 +1,39 @@
+# Headless end-to-end benchmark of the per-tick cost of TimeDisplay
+# Build with qmake tickbench.pro && make, then run ./tickbench --help
+# Needs Qt5 for the offscreen platform plugin
+
+TEMPLATE      = app
+TARGET        = tickbench
+INCLUDEPATH  += ..
+VPATH        += ..
+OBJECTS_DIR   = .obj/tickbench # the targets share a directory
+MOC_DIR       = .moc/tickbench
+
+HEADERS       = Fixture.h TimeDisplay.h ClockCanvas.h ClockSource.h FramePacer.h GlyphAtlas.h Housekeeper.h LeapFetcher.h LeapFile.h LeapMonitor.h LeapTable.h LuminanceTable.h PowerManager.h TextLayer.h Theme.h TickScheduler.h TickStats.h TimeFormatter.h TimeScales.h ZoneInfo.h
+SOURCES       = TickBench.cpp \
+								Fixture.cpp \
+								TimeDisplay.cpp \
+								ClockCanvas.cpp \
+								ClockSource.cpp \
+								FramePacer.cpp \
+								GlyphAtlas.cpp \
+								Housekeeper.cpp \
+								LeapFetcher.cpp \
+								LeapFile.cpp \
+								LeapMonitor.cpp \
+								LeapTable.cpp \
+								LuminanceTable.cpp \
+								PowerManager.cpp \
+								TextLayer.cpp \
+								Theme.cpp \
+								TickScheduler.cpp \
+								TickStats.cpp \
+								TimeFormatter.cpp \
+								TimeScales.cpp \
+								ZoneInfo.cpp
+QT           += core gui network xml
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG      += release c++11
+DEFINES      += QT_NO_DEBUG_OUTPUT # qDebug() chatter would swamp the timings
+DEFINES      += FIXTUREDIR=\\\"$$PWD/fixture\\\"
@@ -1,10 +1,27 @@
-HEADERS       = TimeDisplay.h PowerManager.h
+HEADERS       = TimeDisplay.h ClockCanvas.h ClockSource.h FramePacer.h GlyphAtlas.h Housekeeper.h LeapFetcher.h LeapFile.h LeapMonitor.h LeapTable.h LuminanceTable.h PowerManager.h TextLayer.h Theme.h TickScheduler.h TickStats.h TimeFormatter.h TimeScales.h ZoneInfo.h
 SOURCES       = TimeDisplay.cpp \
                 Main.cpp \
-								PowerManager.cpp
+								ClockCanvas.cpp \
+								ClockSource.cpp \
+								FramePacer.cpp \
+								GlyphAtlas.cpp \
+								Housekeeper.cpp \
+								LeapFetcher.cpp \
+								LeapFile.cpp \
+								LeapMonitor.cpp \
+								LeapTable.cpp \
+								LuminanceTable.cpp \
+								PowerManager.cpp \
+								TextLayer.cpp \
+								Theme.cpp \
+								TickScheduler.cpp \
+								TickStats.cpp \
+								TimeFormatter.cpp \
+								TimeScales.cpp \
+								ZoneInfo.cpp
 QT           += core gui network xml
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-CONFIG      += debug
+CONFIG      += debug c++11
 #DEFINES      += QT_NO_DEBUG_OUTPUT
 DEFINES      += DEBUG
\ No newline at end of file